@@ -291,21 +291,21 @@ define the data types manually
 /***************************************************************/
 /**\name	FUNCTION DEFINITIONS      */
 /***************************************************************/
-#define bmp180_calc_temperature(ut)\
-bmp180_get_temperature(ut)
+#define bmp180_calc_temperature(p_bmp180, ut)\
+bmp180_get_temperature(p_bmp180, ut)
 
-#define bmp180_calc_pressure(up)\
-bmp180_get_pressure(up)
+#define bmp180_calc_pressure(p_bmp180, up)\
+bmp180_get_pressure(p_bmp180, up)
 
-#define bmp180_read_ut()\
-bmp180_get_ut()
+#define bmp180_read_ut(p_bmp180)\
+bmp180_get_uncomp_temperature(p_bmp180)
 
-#define bmp180_read_up()\
-bmp180_get_up()
+#define bmp180_read_up(p_bmp180)\
+bmp180_get_uncomp_pressure(p_bmp180)
 
 
-#define bmp180_read_cal_param()\
-bmp180_get_cal_param()
+#define bmp180_read_cal_param(p_bmp180)\
+bmp180_get_calib_param(p_bmp180)
 
 #define smd500_read_cal_param()\
 smd500_get_cal_param()
@@ -424,6 +424,7 @@ s8 (*bus_read)(u8, u8, u8 *, u8)
 /**\name	CONSTANTS       */
 /***************************************************************/
 #define BMP180_RETURN_FUNCTION_TYPE        s8
+#define   BMP180_NULL							(0)
 #define   BMP180_INIT_VALUE						((u8)0)
 #define   BMP180_INITIALIZE_OVERSAMP_SETTING_U8X	((u8)0)
 #define   BMP180_INITIALIZE_SW_OVERSAMP_U8X			((u8)0)
@@ -435,10 +436,25 @@ s8 (*bus_read)(u8, u8, u8 *, u8)
 #define   BMP180_OVERSAMP_SETTING_U8X				((u8)3)
 #define   BMP180_2MS_DELAY_U8X			(2)
 #define   BMP180_3MS_DELAY_U8X			(3)
-#define   BMP180_AVERAGE_U8X			(3)
 #define   BMP180_INVALID_DATA			(0)
 #define   BMP180_CHECK_DIVISOR			(0)
-#define   BMP180_DATA_MEASURE			(3)
+/***************************************************************/
+/**\name	OVERSAMPLING SETTING       */
+/***************************************************************/
+/* Building with BMP180_FIXED_OSS=n specialises the driver for one
+oversampling setting: every shift and conversion delay that depends on
+it, and the 50000 >> oss scale, fold to constants, and
+oversamp_setting only reports n. Without it oversamp_setting is read
+at run time. */
+#ifdef BMP180_FIXED_OSS
+#define BMP180_OSS(p_bmp180)	((u8)BMP180_FIXED_OSS)
+#define BMP180_INITIALIZE_OSS	((u8)BMP180_FIXED_OSS)
+#else
+#define BMP180_OSS(p_bmp180)	((p_bmp180)->oversamp_setting)
+#define BMP180_INITIALIZE_OSS	BMP180_INITIALIZE_OVERSAMP_SETTING_U8X
+#endif
+/* The compensation runs from RAM on the target, see ramfunc.h */
+#include "ramfunc.h"
 #define   BMP180_CALCULATE_TRUE_PRESSURE		(8)
 #define   BMP180_CALCULATE_TRUE_TEMPERATURE		(8)
 #define BMP180_SHIFT_BIT_POSITION_BY_01_BIT			(1)
@@ -607,7 +623,7 @@ struct bmp180_t {
  *  and assign the chip id and I2C address of the BMP180
  *	chip id is read in the register 0xD0 bit from 0 to 7
  *
- *	 @param bmp180 structure pointer.
+ *	 @param p_bmp180 structure pointer.
  *
  *	@note While changing the parameter of the bmp180_t
  *	@note consider the following point:
@@ -626,7 +642,7 @@ struct bmp180_t {
  *
  *
 */
-BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180);
+BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *p_bmp180);
 /**************************************************************/
 /**\name	FUNCTION FOR TEMPERATURE AND PRESSURE READ */
 /**************************************************************/
@@ -635,6 +651,7 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180);
  *	temperature using the uncompensated temperature(ut)
  *	@note For reading the ut data refer : bmp180_read_ut()
  *
+ *	@param p_bmp180 structure pointer.
  *	@param v_uncomp_temperature_u32:
  *	the value of uncompensated temperature
  *
@@ -642,18 +659,21 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180);
  *
  *
 */
-s16 bmp180_get_temperature(u32 v_uncomp_temperature_u32);
+RAMFUNC s16 bmp180_get_temperature(struct bmp180_t *p_bmp180,
+u32 v_uncomp_temperature_u32);
 /*!
  *	@brief this API is used to calculate the true
  *	pressure using the uncompensated pressure(up)
  *	@note For reading the up data refer : bmp180_read_up()
  *
+ *	@param p_bmp180 structure pointer.
  *	@param v_uncomp_pressure_u32: the value of uncompensated pressure
  *
  *	@return Return the value of pressure in steps of 1.0 Pa
  *
 */
-s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32);
+RAMFUNC s32 bmp180_get_pressure(struct bmp180_t *p_bmp180,
+u32 v_uncomp_pressure_u32);
 /**************************************************************/
 /**\name	FUNCTION FOR UNCOMPENSATED PRESSURE AND TEMPERATURE */
 /**************************************************************/
@@ -663,6 +683,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32);
  *	@note 0xF6(MSB) bit from 0 to 7
  *	@note 0xF7(LSB) bit from 0 to 7
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
@@ -670,7 +691,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32);
  *
  *
 */
-u16 bmp180_get_uncomp_temperature(void);
+u16 bmp180_get_uncomp_temperature(struct bmp180_t *p_bmp180);
 /*!
  *	@brief this API is used to read the
  *	uncompensated pressure(up) from the register
@@ -678,13 +699,14 @@ u16 bmp180_get_uncomp_temperature(void);
  *	@note 0xF7(LSB) bit from 0 to 7
  *	@note 0xF8(LSB) bit from 3 to 7
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
  *	@retval -1 -> Error
  *
 */
-u32  bmp180_get_uncomp_pressure(void);
+u32  bmp180_get_uncomp_pressure(struct bmp180_t *p_bmp180);
 /**************************************************************/
 /**\name	FUNCTION FOR CALIBRATION */
 /**************************************************************/
@@ -706,6 +728,7 @@ u32  bmp180_get_uncomp_pressure(void);
  *		MC     |  0xBC   | 0xBD    | 0 to 7
  *		MD     | 0xBE    | 0xBF    | 0 to 7
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
@@ -713,6 +736,7 @@ u32  bmp180_get_uncomp_pressure(void);
  *
  *
 */
-BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(void);
+BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(
+struct bmp180_t *p_bmp180);
 /* __BMP180_H__*/
 #endif
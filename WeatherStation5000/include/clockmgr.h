@@ -0,0 +1,127 @@
+/*
+ * clockmgr.h
+ *
+ *  Core clock scaling. SystemInit leaves the core on the PLL (72 MHz);
+ *  once the station is up it runs from the 12 MHz IRC and only goes back
+ *  to the PLL inside clock_fast() .. clock_release() sections (OLED page
+ *  updates, pressure bursts). clock_delay_ms() waits at the IRC even
+ *  inside a fast section, if the wait is long enough to pay for the
+ *  switches.
+ *
+ *  Each switch drains the UART with interrupts disabled, so the core keeps
+ *  the PLL for CLOCK_HOLD_MS after the last clock_release(), and a fast
+ *  section starting within that time needs no switch. The drop itself is
+ *  made by clock_settle(), from the idle wait of the main loop, not from
+ *  an interrupt that could catch a driver halfway through a transfer.
+ *  That bounds the switches to two per hold time, and costs at most the
+ *  hold at the PLL per fast section.
+ *
+ *  Every switch recomputes what the board derives from the core clock:
+ *  SystemCoreClock, which delay32Ms() scales by on each call, the flash
+ *  wait states, the SysTick reload (keeping what is left of the current
+ *  millisecond, so msTicks does not drift), the UART divisor (with the
+ *  fractional divider, as 12 MHz has no integer divisor near 115200
+ *  baud) and the I2C SCL duty. Drivers with dividers of their own
+ *  register with clock_attach().
+ *
+ *  SysTick samples the mode every millisecond for clock_ms(). Building
+ *  with CLOCK_FIXED keeps the PLL throughout, for comparison.
+ */
+
+#ifndef CLOCKMGR_H_
+#define CLOCKMGR_H_
+
+#include "type.h"
+#include "ramfunc.h"
+
+#define CLOCK_FAST				0		// PLL
+#define CLOCK_IDLE				1		// IRC
+#define CLOCK_MODES				2
+
+#define CLOCK_IRC_HZ			12000000
+
+// Well under the 50 ms default delay between main loop passes, so the
+// core still drops to the IRC in each of them
+#ifndef CLOCK_HOLD_MS
+#define CLOCK_HOLD_MS			10
+#endif
+
+// The Lib_MCU I2C driver's SCL duty (I2SCLH_SCLH/I2SCLL_SCLL 0x180) at
+// 72 MHz; kept at every clock
+#define CLOCK_I2C_HZ			93750
+
+#define CLOCK_MAX_LISTENERS		2
+
+// Called after each switch with the new core clock
+typedef void (*clock_listener_t)(uint32_t hz);
+
+// Takes the current clock as the PLL rate and drops to the IRC. Call
+// once the UART (at uartBaud) and I2C are set up.
+void clock_init(uint32_t uartBaud);
+
+void clock_attach(clock_listener_t listener);
+
+// Nesting: the PLL runs until the last clock_release()
+void clock_fast(void);
+void clock_release(void);
+
+// Ms until the held PLL may be dropped, 0 if it is not held
+uint32_t clock_hold_ms(void);
+
+// Drops to the IRC once the hold after the last clock_release() is over
+void clock_settle(void);
+
+// Waits at the IRC if ms is at least CLOCK_HOLD_MS, else at the current
+// clock
+void clock_delay_ms(uint32_t ms);
+
+uint8_t clock_mode(void);
+
+// From SysTick_Handler
+RAMFUNC void clock_tick(void);
+
+// Milliseconds spent in mode, and switches made, since clock_init()
+uint32_t clock_ms(uint8_t mode);
+uint32_t clock_switches(void);
+
+// Microseconds since reset, from the SysTick count; for timing short
+// sections, as it wraps every 71 minutes
+uint32_t clock_us(void);
+
+// Hardware side, clockhw.c: switches the core to hz (the IRC or the PLL)
+// and updates SystemCoreClock, the flash timing, SysTick, the UART and
+// I2C.
+void clock_hw_set(uint8_t mode, uint32_t hz, uint32_t uartBaud);
+
+// Hardware side: microseconds into the current millisecond
+uint32_t clock_hw_us(void);
+
+// UART divisor for baud from pclk: returns DLM:DLL and sets *pFdr to
+// MULVAL << 4 | DIVADDVAL for the smallest baud rate error.
+static inline uint16_t clock_uart_divisor(uint32_t pclk, uint32_t baud, uint8_t *pFdr)
+{
+	uint32_t mul, add, dl, best = 0, bestErr = 0xFFFFFFFF, rate, err;
+
+	*pFdr = 0x10;
+	for (mul = 1; mul <= 15; mul++)
+	{
+		for (add = 0; add < mul; add++)
+		{
+			// baud = pclk / (16 * dl * (1 + add / mul))
+			dl = (pclk * mul / (8 * baud * (mul + add)) + 1) / 2;
+			if (dl == 0 || dl > 0xFFFF || (add > 0 && dl < 3))
+				continue;
+			rate = pclk * mul / (16 * dl * (mul + add));
+			err = (rate > baud) ? rate - baud : baud - rate;
+			if (err < bestErr)
+			{
+				bestErr = err;
+				best = dl;
+				*pFdr = (uint8_t)(mul << 4 | add);
+			}
+		}
+	}
+	return (uint16_t)best;
+}
+
+#endif /* CLOCKMGR_H_ */
@@ -0,0 +1,57 @@
+/*
+ * decimate.h
+ *
+ *  Integer boxcar decimator (a first-order CIC with differential delay 1):
+ *  it sums 2^log2Ratio inputs, emits the sum shifted right by 'shift' and
+ *  starts over. With shift == log2Ratio that is a plain average; with
+ *  shift == 0 the output keeps log2Ratio extra bits.
+ *
+ *  Summing 2^k BMP180 conversions at OSS 0 without dividing gives an up on
+ *  the OSS k scale (the chip does the same sum internally at OSS k), so the
+ *  Bosch compensation can be run on it with oss = k.
+ *
+ *  Header-only; shared by the firmware drivers and the host tools.
+ */
+
+#ifndef DECIMATE_H_
+#define DECIMATE_H_
+
+#include <stdint.h>
+
+struct decimate {
+	uint32_t acc;
+	uint16_t count;
+	uint8_t log2Ratio;
+	uint8_t shift;
+};
+
+static inline void decimate_init(struct decimate *pDec, uint8_t log2Ratio, uint8_t shift)
+{
+	pDec->acc = 0;
+	pDec->count = 0;
+	pDec->log2Ratio = log2Ratio;
+	pDec->shift = shift;
+}
+
+// Adds one input. Returns 1 and stores an output in *pOut once every
+// 2^log2Ratio inputs. Inputs must be below 2^(32 - log2Ratio).
+static inline uint8_t decimate_push(struct decimate *pDec, uint32_t in, uint32_t *pOut)
+{
+	pDec->acc += in;
+	if (++pDec->count < (1u << pDec->log2Ratio))
+		return 0;
+
+	*pOut = pDec->acc >> pDec->shift;
+	pDec->acc = 0;
+	pDec->count = 0;
+	return 1;
+}
+
+// Drops a partly filled output, e.g. when the input stream restarts.
+static inline void decimate_reset(struct decimate *pDec)
+{
+	pDec->acc = 0;
+	pDec->count = 0;
+}
+
+#endif /* DECIMATE_H_ */
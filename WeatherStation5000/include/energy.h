@@ -0,0 +1,97 @@
+/*
+ * energy.h
+ *
+ *  Energy model of the station, for sizing batteries and solar panels.
+ *  The active time of each subsystem is taken from where the firmware
+ *  already keeps it (clockmgr.h for the core, the i2csched bus estimate)
+ *  or added up as it goes (BMP180 conversions, OLED updates, UART TX),
+ *  and multiplied by what the subsystem draws while active, from a
+ *  per-board current table.
+ *
+ *  Currents are on top of the board's: the OLED entry is what a page
+ *  update adds to the lit panel, which is part of ENERGY_UA_BOARD. The
+ *  defaults are for the LPCXpresso LPC1343 on the Embedded Artists base
+ *  board with the BMP180 fitted; measure a board and override them.
+ *
+ *  The main loop sends an energy frame (telemetry.h) with the clock and
+ *  latency frames. The host simulation runs the same code, so its
+ *  frames estimate a station from the simulated traffic.
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "type.h"
+
+// Subsystems
+#define ENERGY_BOARD		0	// always: regulator, OLED panel, LED, sensors at rest
+#define ENERGY_CPU_FAST		1	// core on the PLL
+#define ENERGY_CPU_IDLE		2	// core on the IRC, mostly asleep in WFI
+#define ENERGY_I2C			3	// bus held, i2csched estimate
+#define ENERGY_BMP180		4	// converting
+#define ENERGY_OLED			5	// page update over SSP
+#define ENERGY_UART			6	// telemetry being sent
+#define ENERGY_SUBSYSTEMS	7
+
+// Current table, uA
+#ifndef ENERGY_UA_BOARD
+#define ENERGY_UA_BOARD		11000
+#endif
+#ifndef ENERGY_UA_CPU_FAST
+#define ENERGY_UA_CPU_FAST	17000
+#endif
+#ifndef ENERGY_UA_CPU_IDLE
+#define ENERGY_UA_CPU_IDLE	2000
+#endif
+#ifndef ENERGY_UA_I2C
+#define ENERGY_UA_I2C		1500
+#endif
+#ifndef ENERGY_UA_BMP180
+#define ENERGY_UA_BMP180	650
+#endif
+#ifndef ENERGY_UA_OLED
+#define ENERGY_UA_OLED		1000
+#endif
+#ifndef ENERGY_UA_UART
+#define ENERGY_UA_UART		500
+#endif
+
+#ifndef ENERGY_SUPPLY_MV
+#define ENERGY_SUPPLY_MV	3300
+#endif
+
+// BMP180 maximum conversion times (datasheet): ut, and up at an OSS
+#define ENERGY_BMP180_UT_US		4500
+#define ENERGY_BMP180_UP_US(oss)	(1500 + (3000 << (oss)))
+
+struct energy_report {
+	uint32_t intervalMs;
+	uint32_t perSampleUj;
+	uint32_t perHourUwh;				// also the mean power, uW
+	uint32_t uw[ENERGY_SUBSYSTEMS];		// mean power of each subsystem
+};
+
+// Energy of a subsystem active for us, uJ
+static inline uint64_t energy_uj(uint8_t subsystem, uint64_t us)
+{
+	static const uint16_t ua[ENERGY_SUBSYSTEMS] = {
+		ENERGY_UA_BOARD, ENERGY_UA_CPU_FAST, ENERGY_UA_CPU_IDLE, ENERGY_UA_I2C,
+		ENERGY_UA_BMP180, ENERGY_UA_OLED, ENERGY_UA_UART
+	};
+
+	return us * ua[subsystem] * ENERGY_SUPPLY_MV / 1000000000;
+}
+
+// Call with clock_init(); uartBaud times the UART bytes.
+void energy_init(uint32_t uartBaud);
+
+void energy_add_us(uint8_t subsystem, uint32_t us);
+
+// Bytes put on the UART
+void energy_add_uart(uint32_t bytes);
+
+// Fills pReport for the time since the last call (or energy_init()), in
+// which samples telemetry samples were sent, and starts a new interval.
+void energy_take(struct energy_report *pReport, uint32_t samples);
+
+#endif /* ENERGY_H_ */
@@ -0,0 +1,27 @@
+/*
+ * format.h
+ *
+ *  Text formatting for the OLED pages, and the EEPROM snapshot of the last
+ *  readings that SaveCachedData()/RetrieveCachedData() keep at address 240.
+ *  Pure functions, so the host benchmarks them as they run on the board.
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include "type.h"
+
+// EEPROM snapshot: "765;<temp>;<lux>;<pressure>;" in a zero-padded block
+#define SNAPSHOT_SIZE		32
+
+// Writes value in base (2..36) to pBuf, NUL-terminated. pBuf is left
+// untouched if the arguments are invalid or len is too short.
+void intToString(int value, uint8_t* pBuf, uint32_t len, uint32_t base);
+
+// Fills pBuf[SNAPSHOT_SIZE]; pPressure is the pressure as shown.
+void snapshot_encode(char *pBuf, int32_t temp, uint32_t lux, const uint8_t *pPressure);
+
+// Parses pBuf[SNAPSHOT_SIZE]. Returns 0 if it holds no snapshot.
+uint8_t snapshot_decode(const char *pBuf, int32_t *pTemp, uint32_t *pLux, int32_t *pPressure);
+
+#endif /* FORMAT_H_ */
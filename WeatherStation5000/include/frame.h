@@ -0,0 +1,58 @@
+/*
+ * frame.h
+ *
+ *  Binary framing shared by the firmware and the host tools.
+ *
+ *  Every frame on the wire is
+ *
+ *      0xA5 0x5A | type | len | payload[len] | crc8
+ *
+ *  where the CRC-8 (poly 0x07) covers type, len and payload. Plain text
+ *  written to the same UART (boot banner, debug prints) never contains the
+ *  sync pair in practice, so a decoder simply skips it.
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+
+#define FRAME_SYNC0			0xA5
+#define FRAME_SYNC1			0x5A
+#define FRAME_HEADER_SIZE	4
+#define FRAME_MAX_PAYLOAD	32
+#define FRAME_MAX_SIZE		(FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + 1)
+
+/* frame_decoder_feed() results */
+#define FRAME_NONE			0
+#define FRAME_READY			1
+#define FRAME_ERROR			(-1)
+
+struct frame_decoder {
+	uint8_t state;
+	uint8_t type;
+	uint8_t len;
+	uint8_t pos;
+	uint8_t crc;
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+uint8_t frame_crc8(uint8_t crc, const uint8_t *pData, uint32_t len);
+
+// Writes a complete frame into pOut (at least FRAME_MAX_SIZE bytes) and
+// returns its length, or 0 if the payload is too long.
+uint8_t frame_encode(uint8_t *pOut, uint8_t type, const uint8_t *pPayload, uint8_t len);
+
+void frame_decoder_init(struct frame_decoder *pDec);
+
+// Feeds one received byte. Returns FRAME_READY when pDec->type, pDec->len
+// and pDec->payload hold a complete frame with a valid CRC.
+int8_t frame_decoder_feed(struct frame_decoder *pDec, uint8_t byte);
+
+// Little-endian field helpers
+void     frame_put_u16(uint8_t *pBuf, uint16_t value);
+void     frame_put_u32(uint8_t *pBuf, uint32_t value);
+uint16_t frame_get_u16(const uint8_t *pBuf);
+uint32_t frame_get_u32(const uint8_t *pBuf);
+
+#endif /* FRAME_H_ */
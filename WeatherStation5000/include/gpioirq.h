@@ -0,0 +1,34 @@
+/*
+ * gpioirq.h
+ *
+ *  Shares the four PIOINTn interrupts between drivers. Each driver attaches
+ *  a handler to the pins it owns; the port's interrupt clears the pending
+ *  edges and calls every handler whose pins fired.
+ *
+ *  All ports run at GPIOIRQ_PRIORITY, so GPIO handlers never preempt one
+ *  another: state shared between them (an event queue, say) has a single
+ *  writer at any time.
+ */
+
+#ifndef GPIOIRQ_H_
+#define GPIOIRQ_H_
+
+#include "type.h"
+
+#define GPIOIRQ_PRIORITY		2
+
+// Handlers per port
+#define GPIOIRQ_MAX_HANDLERS	2
+
+#define GPIOIRQ_FALLING			0
+#define GPIOIRQ_RISING			1
+#define GPIOIRQ_BOTH			2
+
+// pending: the pins that fired; level: the port's input levels right after
+typedef void (*gpioirq_handler_t)(uint32_t pending, uint32_t level);
+
+// Enables edge interrupts on the pins in mask of port (0..3) and routes
+// them to handler. Returns 0 if the port has no free handler slot.
+uint8_t gpioirq_attach(uint8_t port, uint32_t mask, uint8_t edges, gpioirq_handler_t handler);
+
+#endif /* GPIOIRQ_H_ */
@@ -0,0 +1,78 @@
+/*
+ * i2csched.h
+ *
+ *  Runs the I2C work of one sampling tick across several devices. A job is
+ *  a chain of bus transactions separated by device latencies (a BMP180
+ *  conversion, an EEPROM write cycle); while one device is busy the
+ *  scheduler runs the transactions of the others, so a tick takes about as
+ *  long as its longest chain instead of the sum of all of them.
+ *
+ *  The bus is synchronous, so a transaction holds it until it returns. Bus
+ *  time is estimated from the bytes moved at I2CSCHED_BUS_HZ: drivers bound
+ *  to i2csched_write()/i2csched_read() are counted automatically, library
+ *  calls that do their own I2C report their bytes with i2csched_account().
+ */
+
+#ifndef I2CSCHED_H_
+#define I2CSCHED_H_
+
+#include "type.h"
+
+// SCL frequency of the on-board bus
+#ifndef I2CSCHED_BUS_HZ
+#define I2CSCHED_BUS_HZ		100000
+#endif
+
+// Bus time of n bytes: 8 data bits and an acknowledge each
+#define I2CSCHED_BYTE_US(n)	((uint32_t)((uint64_t)(n) * 9 * 1000000 / I2CSCHED_BUS_HZ))
+
+// Times a failed i2csched_write()/i2csched_read() is tried again; failures
+// and retries are counted in metrics.h
+#ifndef I2CSCHED_RETRIES
+#define I2CSCHED_RETRIES	1
+#endif
+
+// Returned by a step when its job is complete
+#define I2CSCHED_DONE		(-1)
+
+struct i2csched_job {
+	// Runs the job's next transaction and returns the ms until the device
+	// is ready for the following one, or I2CSCHED_DONE.
+	int32_t (*step)(void *pCtx);
+	void *pCtx;
+
+	// Scheduler state
+	uint32_t readyUs;
+	uint8_t done;
+};
+
+struct i2csched_stats {
+	uint32_t runs;
+	uint32_t busUs;			// estimated time the bus was held
+	uint32_t elapsedUs;		// time spent in i2csched_run()
+	uint32_t serialUs;		// bus time plus latencies, had the jobs run one by one
+};
+
+// Bus functions for drivers with busWrite/busRead hooks; addr is the 8-bit
+// address as for I2CWrite()/I2CRead(). Return the status of the last try.
+Status i2csched_write(uint8_t addr, uint8_t *pBuf, uint8_t len);
+Status i2csched_read(uint8_t addr, uint8_t *pBuf, uint8_t len);
+
+// Counts bytes moved outside i2csched_write()/i2csched_read(), including
+// the address bytes.
+void i2csched_account(uint32_t bytes);
+
+// Bytes moved so far, inside i2csched_run() or not; wraps at 2^32
+uint32_t i2csched_bytes(void);
+
+// Runs the jobs to completion, always starting the one that has been ready
+// longest, and sleeps only when every device is busy. Returns the time the
+// run took in us.
+uint32_t i2csched_run(struct i2csched_job *pJobs, uint8_t count);
+
+void i2csched_get_stats(struct i2csched_stats *pStats);
+
+// Bus time over elapsed time of all runs so far, in percent
+uint8_t i2csched_utilisation(void);
+
+#endif /* I2CSCHED_H_ */
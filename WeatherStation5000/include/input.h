@@ -0,0 +1,64 @@
+/*
+ * input.h
+ *
+ *  Interrupt-driven user input: joystick (PIO2_0..PIO2_4), the SW3 button
+ *  (PIO0_1) and the rotary encoder (PIO1_0/PIO1_1). The GPIO interrupts
+ *  decode the encoder and time the key edges; SysTick (input_tick())
+ *  reads a key once its edges have settled. One event is queued per press
+ *  or detent, so nothing is lost between two passes of the main loop.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include "type.h"
+#include "ramfunc.h"
+
+// Events
+#define INPUT_NONE			0
+#define INPUT_LEFT			1
+#define INPUT_RIGHT			2
+#define INPUT_UP			3
+#define INPUT_DOWN			4
+#define INPUT_CENTER		5
+#define INPUT_BUTTON		6
+#define INPUT_ROTARY_RIGHT	7
+#define INPUT_ROTARY_LEFT	8
+
+// A key is read this long after the last edge on its pin
+#ifndef INPUT_DEBOUNCE_MS
+#define INPUT_DEBOUNCE_MS	20
+#endif
+
+// Quadrature steps per encoder detent
+#ifndef INPUT_ROTARY_STEPS
+#define INPUT_ROTARY_STEPS	4
+#endif
+
+// Must be a power of two
+#define INPUT_QUEUE_SIZE	16
+
+// Call after joystick_init() and rotary_init(), which set up the pins.
+void input_init(uint32_t (*getMsTicks)(void));
+
+// From SysTick_Handler: queues the presses of keys that have settled
+RAMFUNC void input_tick(void);
+
+// Returns the oldest queued event, or INPUT_NONE.
+uint8_t input_get(void);
+
+// True when an event is queued, for loops that cannot sleep in input_wait().
+uint8_t input_pending(void);
+
+// Sleeps until ms have passed or an event is queued.
+void input_wait(uint32_t ms);
+
+// Tick count when the event input_get() last returned was pushed or, if
+// others were already waiting then, when the first of them was. The
+// first event after input_get() returned INPUT_NONE waited behind none.
+uint32_t input_event_ms(void);
+
+// Events dropped because the queue was full
+uint32_t input_overflows(void);
+
+#endif /* INPUT_H_ */
@@ -0,0 +1,51 @@
+/*
+ * latency.h
+ *
+ *  Latency histograms of the paths a user waits on, in ms. Buckets are
+ *  powers of two: bucket 0 holds 0 ms, bucket b holds 2^(b-1) up to
+ *  2^b - 1 ms, and the last one everything from 2^(LATENCY_BUCKETS-2)
+ *  ms up. Recording is a count-leading-zeros and an increment; the worst
+ *  case is kept exactly besides.
+ *
+ *  The main loop records them and sends each in a TLM_LATENCY frame
+ *  every TELEMETRY_STATS_EVERY samples, starting it over (telemetry.h).
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include "type.h"
+
+// Paths
+#define LATENCY_SAMPLE_DISPLAY	0	// sensor read started to the value drawn on the OLED
+#define LATENCY_INPUT_PAGE		1	// joystick/rotary edge to the page redrawn
+#define LATENCY_SAMPLE_UART		2	// sensor read started to the telemetry frame sent
+#define LATENCY_PATHS			3
+
+#define LATENCY_BUCKETS			12
+
+struct latency_hist {
+	uint32_t counts[LATENCY_BUCKETS];
+	uint32_t maxMs;
+};
+
+static inline uint8_t latency_bucket(uint32_t ms)
+{
+	uint8_t b = (ms == 0) ? 0 : (uint8_t)(32 - __builtin_clz(ms));
+
+	return (b < LATENCY_BUCKETS) ? b : LATENCY_BUCKETS - 1;
+}
+
+// Smallest latency in bucket b, ms
+static inline uint32_t latency_bucket_ms(uint8_t b)
+{
+	return (b == 0) ? 0 : 1UL << (b - 1);
+}
+
+void latency_record(uint8_t path, uint32_t ms);
+
+const struct latency_hist *latency_get(uint8_t path);
+
+void latency_clear(uint8_t path);
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,55 @@
+/*
+ * metrics.h
+ *
+ *  Registry of the station's health counters and gauges, for a field tech
+ *  to see why a station is slow without a debugger: on the diagnostics
+ *  page of the OLED and in TLM_METRICS frames (telemetry.h).
+ *
+ *  Counters only go up, from reset; gauges hold the latest value. Updates
+ *  are atomic (LDREX/STREX on the Cortex-M3), so interrupt handlers and
+ *  the main loop can update the same metric.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "type.h"
+
+// Metrics
+#define METRIC_UPTIME_S			0	// counter, s since reset
+#define METRIC_LOOP_OVERRUNS	1	// counter, passes whose work took longer than the loop delay
+#define METRIC_I2C_ERRORS		2	// counter, failed I2C transactions, retries included
+#define METRIC_I2C_RETRIES		3	// counter
+#define METRIC_READS_TEMP		4	// counter, readings taken, in SAMPLE_* channel order
+#define METRIC_READS_LIGHT		5
+#define METRIC_READS_PRESSURE	6
+#define METRIC_EEPROM_WRITES	7	// counter
+#define METRIC_TLM_DROPPED		8	// counter, bytes of sample frames missing, see TELEMETRY_MAX_PERIOD_MS
+#define METRIC_INPUT_DROPPED	9	// counter, input events lost to a full queue
+#define METRIC_STACK_PEAK		10	// gauge, bytes (stackmon.h)
+#define METRICS					11
+
+// Display name, at most METRICS_NAME_MAX characters
+#define METRICS_NAME_MAX		7
+
+// Storage, for the inline accessors only
+extern uint32_t metricsValues[METRICS];
+
+const char *metrics_name(uint8_t id);
+
+static inline void metrics_add(uint8_t id, uint32_t n)
+{
+	__atomic_fetch_add(&metricsValues[id], n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_set(uint8_t id, uint32_t value)
+{
+	__atomic_store_n(&metricsValues[id], value, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t metrics_get(uint8_t id)
+{
+	return __atomic_load_n(&metricsValues[id], __ATOMIC_RELAXED);
+}
+
+#endif /* METRICS_H_ */
@@ -9,8 +9,134 @@
 #define PRESSURE_H_
 
 #include "i2c.h"
+#include "bmp180.h"
+#include "decimate.h"
+#include "i2csched.h"
 
-uint8_t init_pressure();
-long get_pressure();
+// Oversampling setting of the pressure conversions. Building with
+// BMP180_FIXED_OSS specialises the driver for it, see bmp180.h.
+#ifdef BMP180_FIXED_OSS
+#define PRESSURE_OSS		BMP180_FIXED_OSS
+#else
+#define PRESSURE_OSS		0
+#endif
+
+// Calibration PROM, 11 big-endian words from register 0xAA
+#define PRESSURE_PROM_SIZE	BMP180_PROM_DATA__LEN
+
+// A pressure read reuses the last temperature conversion (ut, b5) until it
+// is this old, or until pressure_note_temperature() reports the board has
+// warmed or cooled by PRESSURE_B5_MAX_DELTA (in 0.1 C, so 0.5 C by
+// default) since. Set the age to 0 to convert temperature before every
+// pressure.
+#ifndef PRESSURE_B5_MAX_AGE_MS
+#define PRESSURE_B5_MAX_AGE_MS	1000
+#endif
+#ifndef PRESSURE_B5_MAX_DELTA
+#define PRESSURE_B5_MAX_DELTA	5
+#endif
+
+// Burst mode runs OSS 0 conversions back to back (about 5 ms each) and
+// decimates them twice: 2^PRESSURE_OSS conversions are summed into a fast
+// output on the PRESSURE_OSS scale, and 2^SLOW_LOG2 fast outputs are
+// averaged into a slow one. Built with BMP180_FIXED_OSS=2 that is one fast
+// output per 20 ms and, by default, one slow output per 640 ms.
+#ifndef PRESSURE_BURST_SLOW_LOG2
+#define PRESSURE_BURST_SLOW_LOG2	5
+#endif
+
+// pressure_job_step() states
+#define PRESSURE_JOB_IDLE		0
+#define PRESSURE_JOB_UT			1
+#define PRESSURE_JOB_UP			2
+
+// pressure_burst_step() results
+#define PRESSURE_BURST_FAST		0x01
+#define PRESSURE_BURST_SLOW		0x02
+
+// State of one BMP180. Nothing is kept in globals, so any number of
+// sensors (on separate buses) or simulated stations can run side by side.
+struct pressure_t {
+	// Bus access, chip id and calibration, through the Bosch driver
+	struct bmp180_t bmp;
+
+	// Temperature refresh policy state, see PRESSURE_B5_MAX_AGE_MS. The
+	// cached b5 itself is bmp.param_b5.
+	uint32_t (*getMsTicks)(void);	// NULL: refresh every time
+	uint32_t b5Ms;
+	int32_t b5Ambient;
+	int32_t ambient;
+	uint8_t b5Valid;
+
+	// Conversions started, for bus time accounting
+	uint32_t tempConversions;
+	uint32_t pressConversions;
+
+	// pressure_job_step() state
+	uint8_t jobState;
+
+	// Set when the last reading failed on the bus; ut, up and the results
+	// then keep the previous reading's values
+	uint8_t failed;
+
+	// Last raw conversions
+	uint16_t ut;
+	uint32_t up;
+
+	int16_t temperature;
+	int32_t pressure;
+
+	// Burst mode: up and pressure hold the fast output, slowUp and
+	// slowPressure the slow one.
+	struct decimate fast;
+	struct decimate slow;
+	uint32_t slowUp;
+	int32_t slowPressure;
+};
+
+// Binds pPress to the BMP180 on the on-board I2C bus, through i2csched.
+void pressure_default_bus(struct pressure_t *pPress);
+
+// Gives the driver a ms clock so it can reuse temperature conversions.
+void pressure_set_clock(struct pressure_t *pPress, uint32_t (*getMsTicks)(void));
+
+// Reports the board temperature (0.1 C, any sensor); a large enough change
+// since the last temperature conversion forces a new one.
+void pressure_note_temperature(struct pressure_t *pPress, int32_t ambient);
+
+// Reads the chip id and the calibration. Returns 1 if a BMP180 answered.
+uint8_t init_pressure(struct pressure_t *pPress);
+int32_t get_pressure(struct pressure_t *pPress);
+
+// Runs a pressure conversion, and a temperature conversion if the policy
+// asks for one, and leaves the raw results in pPress->ut and pPress->up
+// without compensating them. ut is the one b5 was last computed from.
+void pressure_read_raw(struct pressure_t *pPress);
+
+// Split conversions, for callers that use the bus while the chip converts.
+// Each start returns the ms to wait before the matching finish. A
+// temperature conversion is due when the cached b5 is stale. A bus error
+// sets pPress->failed, which the caller clears before each reading.
+uint8_t pressure_temperature_due(struct pressure_t *pPress);
+uint8_t pressure_start_temperature(struct pressure_t *pPress);
+void pressure_finish_temperature(struct pressure_t *pPress);
+uint8_t pressure_start_pressure(struct pressure_t *pPress);
+void pressure_finish_pressure(struct pressure_t *pPress);
+
+// i2csched step (pCtx: the pressure_t) doing what get_pressure() does.
+int32_t pressure_job_step(void *pCtx);
+
+// Starts burst mode with 2^PRESSURE_OSS conversions per fast output and
+// 2^slowLog2 fast outputs per slow output.
+void pressure_burst_start(struct pressure_t *pPress, uint8_t slowLog2);
+
+// Runs one OSS 0 conversion through the decimators, preceded by a
+// temperature conversion when a fast output is about to start and the
+// cached b5 is stale. Returns PRESSURE_BURST_FAST and/or PRESSURE_BURST_SLOW
+// when the respective output was updated.
+uint8_t pressure_burst_step(struct pressure_t *pPress);
+
+// Copies the calibration to pProm[PRESSURE_PROM_SIZE] as the chip stores it.
+void pressure_prom(const struct pressure_t *pPress, uint8_t *pProm);
 
 #endif /* PRESSURE_H_ */
@@ -3,7 +3,10 @@
 
 #include "../include/bmp180.h"
 
-s32 BMP180Init();
+// Binds the driver to the on-board I2C bus (through i2csched) and delay
+void BMP180Bus(struct bmp180_t *bmp180);
+
+s32 BMP180Init(struct bmp180_t *bmp180);
 
 
 
@@ -0,0 +1,31 @@
+/*
+ * rambench.h
+ *
+ *  On-board measurement for ramfunc.h, built in with RAMFUNC_BENCH. At
+ *  boot the firmware prints over the UART, as min/mean/max cycles over
+ *  RAMBENCH_RUNS (max - min being the jitter):
+ *
+ *  - SysTick entry: from the counter reload to the first instruction of
+ *    SysTick_Handler, i.e. exception entry with its vector and code
+ *    fetches, taken from a main loop busy in flash
+ *  - compensation: bmp180_get_temperature() + bmp180_get_pressure() on
+ *    the datasheet calibration, interrupts off, from the DWT cycle counter
+ *
+ *  and the bytes of code in RAM. Build it once more with RAMFUNC_DISABLE
+ *  for the same figures from flash.
+ */
+
+#ifndef RAMBENCH_H_
+#define RAMBENCH_H_
+
+#include "type.h"
+
+#define RAMBENCH_RUNS		256
+
+// SysTick_Handler passes the cycles since the reload.
+void rambench_tick(uint32_t cycles);
+
+// Runs both measurements and prints them; needs the UART and SysTick.
+void rambench_run(void);
+
+#endif /* RAMBENCH_H_ */
@@ -0,0 +1,30 @@
+/*
+ * ramfunc.h
+ *
+ *  RAMFUNC places a function in SRAM. At 72 MHz the LPC1343 reads flash
+ *  with wait states, so code that runs often or must run in constant
+ *  time (interrupt handlers, the compensation math) is faster and steadier
+ *  from RAM.
+ *
+ *  The functions go in the .ramfunc section, which ramfunc.ld adds to the
+ *  managed linker script after .data; ResetISR copies it from flash next
+ *  to the .data initialisers. Every byte comes out of the 8 KB the stack
+ *  shares (see stackmon.h), so mark only what a measurement justifies
+ *  (RAMFUNC_BENCH, rambench.h).
+ *
+ *  RAM sits 256 MB away from flash, beyond the reach of a BL, so calls in
+ *  both directions are long calls; put RAMFUNC on the declaration too.
+ *  Building with RAMFUNC_DISABLE, or for the host, leaves everything in
+ *  flash.
+ */
+
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+#if defined(__arm__) && !defined(RAMFUNC_DISABLE)
+#define RAMFUNC		__attribute__((section(".ramfunc"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif /* RAMFUNC_H_ */
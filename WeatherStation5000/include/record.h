@@ -0,0 +1,69 @@
+/*
+ * record.h
+ *
+ *  Raw sensor stream recorder.
+ *
+ *  With RECORD_ENABLE defined every raw input consumed by the main loop
+ *  (BMP180 calibration and ut/up, temperature and light reads, input
+ *  events) is sent over the UART as a timestamped frame, followed by
+ *  the values the loop derived from them. host/sim/replay feeds such a
+ *  capture back through the same sources and checks the outputs match.
+ *
+ *  Replay runs the clock up to the timestamp of the next record, so a
+ *  branch on the clock is recorded (REC_CLOCK) where it is taken: replay
+ *  then evaluates it at the same millisecond.
+ *
+ *  Without RECORD_ENABLE the wrappers compile down to the plain reads.
+ */
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include "type.h"
+
+// Every record payload starts with the uint32_t ms timestamp.
+#define REC_TS_SIZE			4
+
+// Inputs
+#define REC_CALIB			0x10	// 22 byte BMP180 calibration PROM (0xAA..0xBF)
+#define REC_UT				0x11	// uint16_t uncompensated temperature
+#define REC_UP				0x12	// uint32_t uncompensated pressure
+#define REC_TEMP			0x13	// int32_t temperature_read()
+#define REC_LIGHT			0x14	// uint32_t light_read()
+#define REC_INPUT			0x15	// uint8_t input_get(); INPUT_NONE ends a pass
+#define REC_CLOCK			0x16	// uint8_t outcome of a branch on the ms clock
+#define REC_BUS				0x17	// uint8_t 1 if an i2csched transfer succeeded
+
+// Outputs
+#define REC_PRESSURE		0x18	// int32_t compensated pressure (Pa)
+#define REC_TICK			0x19	// end of loop: page, delay, temp, lux
+
+#define REC_IS_INPUT(type)	((type) >= REC_CALIB && (type) <= REC_BUS)
+
+#ifdef RECORD_ENABLE
+
+void record_init(uint32_t (*getMsTicks)(void));
+void record_emit(uint8_t type, const uint8_t *pData, uint8_t len);
+
+uint8_t  record_u8(uint8_t type, uint8_t value);
+uint16_t record_u16(uint8_t type, uint16_t value);
+uint32_t record_u32(uint8_t type, uint32_t value);
+int32_t  record_s32(uint8_t type, int32_t value);
+
+void record_tick(uint8_t page, uint8_t delayMs, int32_t temp, uint32_t lux);
+
+#else
+
+#define record_init(getMsTicks)
+#define record_emit(type, pData, len)
+
+#define record_u8(type, value)		(value)
+#define record_u16(type, value)		(value)
+#define record_u32(type, value)		(value)
+#define record_s32(type, value)		(value)
+
+#define record_tick(page, delayMs, temp, lux)
+
+#endif
+
+#endif /* RECORD_H_ */
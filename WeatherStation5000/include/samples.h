@@ -0,0 +1,98 @@
+/*
+ * samples.h
+ *
+ *  Latest reading of each sensor channel, shared by the display, the
+ *  EEPROM cache and the telemetry. A consumer asks for a value no older
+ *  than some age, and the sensor is read only when the cached one is
+ *  older. Stale I2C channels requested together are read in one i2csched
+ *  pass, so the light sensor is read while the BMP180 converts.
+ *
+ *  Each channel also has a sampling period of its own, which a caller
+ *  asks for by passing SAMPLE_PERIOD as the age; any other age is a hard
+ *  bound. The period starts at SAMPLE_MIN_PERIOD_MS and doubles with
+ *  every reading taken for it that stays within the channel's step of
+ *  the reference reading, up to the channel's maximum; any reading past
+ *  the step drops it back to the minimum and becomes the reference. A
+ *  slow drift therefore still brings the fast rate back once it adds up
+ *  to a step. Setting the maximum to the minimum samples at a fixed rate.
+ */
+
+#ifndef SAMPLES_H_
+#define SAMPLES_H_
+
+#include "type.h"
+#include "pressure.h"
+
+// Channels
+#define SAMPLE_TEMP			0	// 0.1 C, temperature_read()
+#define SAMPLE_LIGHT		1	// lux, light_read()
+#define SAMPLE_PRESSURE		2	// Pa, BMP180
+#define SAMPLE_CHANNELS		3
+
+#define SAMPLE_MASK(channel)	(1 << (channel))
+#define SAMPLE_ALL				((1 << SAMPLE_CHANNELS) - 1)
+
+// As maxAgeMs: whenever the channel's sampling period has passed
+#define SAMPLE_PERIOD			0xFFFFFFFFu
+
+#ifndef SAMPLE_MIN_PERIOD_MS
+#define SAMPLE_MIN_PERIOD_MS			500
+#endif
+#ifndef SAMPLE_MAX_PERIOD_TEMP_MS
+#define SAMPLE_MAX_PERIOD_TEMP_MS		16000
+#endif
+#ifndef SAMPLE_MAX_PERIOD_LIGHT_MS
+#define SAMPLE_MAX_PERIOD_LIGHT_MS		2000
+#endif
+#ifndef SAMPLE_MAX_PERIOD_PRESSURE_MS
+#define SAMPLE_MAX_PERIOD_PRESSURE_MS	16000
+#endif
+
+// Steps, in the channel's unit. The light step grows to
+// 1/2^SAMPLE_STEP_LIGHT_SHIFT of the reading when that is larger, so the
+// noise of daylight readings does not hold the channel at the fast rate.
+#ifndef SAMPLE_STEP_TEMP
+#define SAMPLE_STEP_TEMP				2		// 0.2 C
+#endif
+#ifndef SAMPLE_STEP_LIGHT
+#define SAMPLE_STEP_LIGHT				20
+#endif
+#ifndef SAMPLE_STEP_LIGHT_SHIFT
+#define SAMPLE_STEP_LIGHT_SHIFT			3
+#endif
+#ifndef SAMPLE_STEP_PRESSURE
+#define SAMPLE_STEP_PRESSURE			20		// 0.2 hPa
+#endif
+
+// pPress is the initialised BMP180, or NULL if there is none; the pressure
+// channel then stays 0.
+void samples_init(uint32_t (*getMsTicks)(void), struct pressure_t *pPress);
+
+// Reads the channels in mask whose value is maxAgeMs old or older (all of
+// them for 0, those past their period for SAMPLE_PERIOD). Returns the mask
+// of channels read.
+uint8_t samples_refresh(uint8_t mask, uint32_t maxAgeMs);
+
+// Value of channel, read first if it is maxAgeMs old or older.
+int32_t samples_get(uint8_t channel, uint32_t maxAgeMs);
+
+// Stores a reading taken outside the cache (pressure burst mode). From
+// then on the cache no longer reads channel itself.
+void samples_put(uint8_t channel, int32_t value);
+
+// Channels read since the last call, for a consumer that only wants new
+// readings (the telemetry)
+uint8_t samples_updated(void);
+
+// Current sampling period of channel, ms
+uint32_t samples_period(uint8_t channel);
+
+// Tick count the oldest reading of the channels in mask was started at
+// (the current one if none has been read).
+uint32_t samples_read_ms(uint8_t mask);
+
+// Requests and physical reads of channel since samples_init()
+uint32_t samples_requests(uint8_t channel);
+uint32_t samples_reads(uint8_t channel);
+
+#endif /* SAMPLES_H_ */
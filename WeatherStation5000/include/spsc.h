@@ -0,0 +1,116 @@
+/*
+ * spsc.h
+ *
+ *  Bounded single-producer/single-consumer ring of fixed-size elements,
+ *  shared by the firmware (interrupt -> main loop) and the host tools
+ *  (thread -> thread).
+ *
+ *  The producer only writes head and the consumer only writes tail, so
+ *  neither side takes a lock or masks interrupts. Indices run freely and
+ *  wrap at 2^32; head - tail is the fill level. Element contents are
+ *  published by a release store of the index and picked up by an acquire
+ *  load of it. On the Cortex-M3 these compile to a DMB next to the plain
+ *  load/store, which keeps both the compiler and the bus from reordering
+ *  the slot accesses across the index update.
+ *
+ *  The caller provides the slot storage: capacity * elemSize bytes, with
+ *  capacity a power of two.
+ */
+
+#ifndef SPSC_H_
+#define SPSC_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Keeps the two indices on separate cache lines on the host; the
+// Cortex-M3 has no data cache and no RAM to spare.
+#if defined(__arm__) || defined(__thumb__)
+#define SPSC_INDEX_ALIGN
+#else
+#define SPSC_INDEX_ALIGN	__attribute__((aligned(64)))
+#endif
+
+struct spsc {
+	uint8_t *pSlots;
+	uint32_t elemSize;
+	uint32_t mask;
+	uint32_t head SPSC_INDEX_ALIGN;		// next slot to write, producer only
+	uint32_t tail SPSC_INDEX_ALIGN;		// next slot to read, consumer only
+};
+
+// Returns 0, or -1 if capacity is not a power of two.
+static inline int spsc_init(struct spsc *pRing, void *pStorage, uint32_t elemSize, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > 0x80000000u)
+		return -1;
+	pRing->pSlots = (uint8_t *)pStorage;
+	pRing->elemSize = elemSize;
+	pRing->mask = capacity - 1;
+	pRing->head = 0;
+	pRing->tail = 0;
+	return 0;
+}
+
+// Copies count elements starting at index 'first' between the ring and
+// pElems, in at most two runs around the wrap.
+static inline void spsc_copy(struct spsc *pRing, uint32_t first, uint8_t *pElems, uint32_t count,
+	int toRing)
+{
+	uint32_t start = first & pRing->mask;
+	uint32_t run = pRing->mask + 1 - start;
+	uint8_t *pSlot = pRing->pSlots + start * pRing->elemSize;
+
+	if (run > count)
+		run = count;
+	if (toRing)
+	{
+		memcpy(pSlot, pElems, run * pRing->elemSize);
+		memcpy(pRing->pSlots, pElems + run * pRing->elemSize, (count - run) * pRing->elemSize);
+	}
+	else
+	{
+		memcpy(pElems, pSlot, run * pRing->elemSize);
+		memcpy(pElems + run * pRing->elemSize, pRing->pSlots, (count - run) * pRing->elemSize);
+	}
+}
+
+// Producer side. Returns the number of elements queued (<= count).
+static inline uint32_t spsc_push(struct spsc *pRing, const void *pElems, uint32_t count)
+{
+	uint32_t head = pRing->head;
+	uint32_t tail = __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+	uint32_t space = pRing->mask + 1 - (head - tail);
+
+	if (count > space)
+		count = space;
+	if (count == 0)
+		return 0;
+	spsc_copy(pRing, head, (uint8_t *)pElems, count, 1);
+	__atomic_store_n(&pRing->head, head + count, __ATOMIC_RELEASE);
+	return count;
+}
+
+// Consumer side. Returns the number of elements dequeued (<= max).
+static inline uint32_t spsc_pop(struct spsc *pRing, void *pElems, uint32_t max)
+{
+	uint32_t tail = pRing->tail;
+	uint32_t head = __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE);
+	uint32_t avail = head - tail;
+
+	if (max > avail)
+		max = avail;
+	if (max == 0)
+		return 0;
+	spsc_copy(pRing, tail, (uint8_t *)pElems, max, 0);
+	__atomic_store_n(&pRing->tail, tail + max, __ATOMIC_RELEASE);
+	return max;
+}
+
+// Elements queued, as seen from either side
+static inline uint32_t spsc_count(struct spsc *pRing)
+{
+	return __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif /* SPSC_H_ */
@@ -0,0 +1,36 @@
+/*
+ * stackmon.h
+ *
+ *  Stack high-water mark. ResetISR paints the RAM between the end of .bss
+ *  and the stack pointer with STACKMON_PAINT before anything runs on it;
+ *  the deepest word no longer holding the pattern marks the peak use.
+ *
+ *  The managed linker script starts the heap at _ebss too, so anything
+ *  malloc()ed (by the C library's printf, say) counts as stack here: the
+ *  peak is an upper bound, and the headroom left is
+ *  stackmon_size() - stackmon_peak().
+ *
+ *  Per-module .data/.bss use comes from the map file, see ws_ram_report
+ *  in host/.
+ */
+
+#ifndef STACKMON_H_
+#define STACKMON_H_
+
+#include "type.h"
+
+#define STACKMON_PAINT		0xC5C5C5C5
+
+// Paints [_ebss, sp). Called by ResetISR once .bss is zeroed.
+void stackmon_paint(void);
+
+// Bytes between _ebss and _vStackTop: the stack and heap together
+uint32_t stackmon_size(void);
+
+// Deepest stack use since reset, in bytes below _vStackTop
+uint32_t stackmon_peak(void);
+
+// Bytes of .data, the RAM functions (ramfunc.h) and .bss
+uint32_t stackmon_static(void);
+
+#endif /* STACKMON_H_ */
@@ -0,0 +1,166 @@
+/*
+ * telemetry.h
+ *
+ *  Sample frames sent to the back-office collector over the UART, using the
+ *  framing from frame.h. Payloads are little-endian.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "type.h"
+#include "energy.h"
+#include "latency.h"
+
+#ifndef TELEMETRY_STATION_ID
+#define TELEMETRY_STATION_ID	1
+#endif
+
+// Minimum time between two sample frames
+#ifndef TELEMETRY_PERIOD_MS
+#define TELEMETRY_PERIOD_MS		1000
+#endif
+
+// Maximum: the main loop sends a sample frame when the sample cache has
+// new readings (see samples.h), and at least this often when it has none
+#ifndef TELEMETRY_MAX_PERIOD_MS
+#define TELEMETRY_MAX_PERIOD_MS	16000
+#endif
+
+// station u16 | seq u16 | ms u32 | temp s16 (0.1 C) | lux u32 | pressure s32 (Pa)
+#define TLM_SAMPLE				0x01
+#define TLM_SAMPLE_SIZE			18
+
+#define TLM_OFS_STATION			0
+#define TLM_OFS_SEQ				2
+#define TLM_OFS_MS				4
+#define TLM_OFS_TEMP			8
+#define TLM_OFS_LUX				10
+#define TLM_OFS_PRESSURE		14
+
+// Raw mode (TELEMETRY_RAW): the station ships the BMP180 calibration and
+// raw conversions and leaves compensation to the collector.
+//
+// station u16 | oss u8 | PROM[22] as read from 0xAA (big-endian words)
+#define TLM_CALIB				0x02
+#define TLM_CALIB_SIZE			25
+
+#define TLM_OFS_CALIB_OSS		2
+#define TLM_OFS_CALIB_PROM		3
+
+// station u16 | seq u16 | ms u32 | temp s16 (0.1 C) | lux u32 | ut u16 | up u32
+#define TLM_RAW					0x03
+#define TLM_RAW_SIZE			20
+
+#define TLM_OFS_UT				14
+#define TLM_OFS_UP				16
+
+// The calibration goes out before the first raw sample and again every
+// TELEMETRY_CALIB_EVERY samples, so a collector that connects mid-session
+// can start compensating.
+#ifndef TELEMETRY_CALIB_EVERY
+#define TELEMETRY_CALIB_EVERY	64
+#endif
+
+// RAM use, sent at boot and whenever the stack high-water mark grows
+// (see stackmon.h). All in bytes: .data + .bss, the room from _ebss to
+// _vStackTop, and the deepest stack use so far.
+//
+// station u16 | static u16 | stack u16 | stack peak u16
+#define TLM_MEMORY				0x04
+#define TLM_MEMORY_SIZE			8
+
+#define TLM_OFS_MEM_STATIC		2
+#define TLM_OFS_MEM_STACK		4
+#define TLM_OFS_MEM_PEAK		6
+
+// Clock, latency, metrics and energy frames go out every
+// TELEMETRY_STATS_EVERY samples
+#ifndef TELEMETRY_STATS_EVERY
+#define TELEMETRY_STATS_EVERY	60
+#endif
+
+// Time the core spent on the PLL and on the IRC since it was brought up,
+// in ms, and the switches between them (see clockmgr.h)
+//
+// station u16 | fast ms u32 | idle ms u32 | switches u32
+#define TLM_CLOCK				0x05
+#define TLM_CLOCK_SIZE			14
+
+#define TLM_OFS_CLOCK_FAST		2
+#define TLM_OFS_CLOCK_IDLE		6
+#define TLM_OFS_CLOCK_SWITCHES	10
+
+// One latency histogram (see latency.h), covering the time since the
+// last frame for its path. Values above 65535 saturate.
+//
+// station u16 | path u8 | max ms u16 | count u16 per bucket
+#define TLM_LATENCY				0x06
+#define TLM_LATENCY_SIZE		(5 + 2 * LATENCY_BUCKETS)
+
+#define TLM_OFS_LAT_PATH		2
+#define TLM_OFS_LAT_MAX			3
+#define TLM_OFS_LAT_COUNTS		5
+
+// The metrics registry (metrics.h), TLM_METRICS_PER_FRAME values a frame
+// from the one numbered first.
+//
+// station u16 | first u8 | count u8 | value u32 per metric
+#define TLM_METRICS				0x07
+#define TLM_METRICS_PER_FRAME	6
+#define TLM_METRICS_SIZE(count)	(4 + 4 * (count))
+
+#define TLM_OFS_MET_FIRST		2
+#define TLM_OFS_MET_COUNT		3
+#define TLM_OFS_MET_VALUES		4
+
+// Energy estimate (energy.h) over the time since the last frame: per
+// telemetry sample, per hour (uWh, so also the mean power in uW), and the
+// mean power of each subsystem in uW, saturating at 65535.
+//
+// station u16 | interval ms u32 | per sample uJ u32 | per hour uWh u32 |
+// power uW u16 per subsystem
+#define TLM_ENERGY				0x08
+#define TLM_ENERGY_SIZE			(14 + 2 * ENERGY_SUBSYSTEMS)
+
+#define TLM_OFS_EN_INTERVAL		2
+#define TLM_OFS_EN_SAMPLE		6
+#define TLM_OFS_EN_HOUR			10
+#define TLM_OFS_EN_POWER		14
+
+void telemetry_init(void);
+
+// True if TELEMETRY_PERIOD_MS has passed between the last sample frame
+// and ms.
+uint8_t telemetry_due(uint32_t ms);
+
+// True if TELEMETRY_MAX_PERIOD_MS has passed between the last sample
+// frame and ms.
+uint8_t telemetry_overdue(uint32_t ms);
+
+// Sends a sample frame for a sample taken at ms if telemetry_due(ms).
+void telemetry_sample(uint32_t ms, int32_t temp, uint32_t lux, int32_t pressure);
+
+// Raw mode: stores the calibration to send with the raw samples.
+void telemetry_calibration(const uint8_t *pProm, uint8_t oss);
+
+// Raw mode: sends a raw sample frame for a sample taken at ms if
+// telemetry_due(ms).
+void telemetry_raw(uint32_t ms, int32_t temp, uint32_t lux, uint16_t ut, uint32_t up);
+
+// Sends a memory frame.
+void telemetry_memory(uint16_t staticBytes, uint16_t stackBytes, uint16_t peakBytes);
+
+// Sends a clock frame.
+void telemetry_clock(uint32_t fastMs, uint32_t idleMs, uint32_t switches);
+
+// Sends a latency frame for path.
+void telemetry_latency(uint8_t path, const struct latency_hist *pHist);
+
+// Sends the metrics registry.
+void telemetry_metrics(void);
+
+// Sends an energy frame.
+void telemetry_energy(const struct energy_report *pReport);
+
+#endif /* TELEMETRY_H_ */
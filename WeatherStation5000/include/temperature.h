@@ -0,0 +1,43 @@
+/*
+ * temperature.h
+ *
+ *  Background measurement of the MAX6576 on PIO1_5. The sensor outputs a
+ *  square wave whose period is proportional to absolute temperature. Each
+ *  rising edge is timestamped from CT32B1, free-running at 1 MHz (CT32B0
+ *  belongs to delay32Ms), and the periods are averaged over a window in
+ *  the GPIO interrupt, so reading the temperature costs nothing.
+ *
+ *  temp_read() from the board library blocks for about half a second per
+ *  call while it counts edges; temperature_read() returns at once.
+ */
+
+#ifndef TEMPERATURE_H_
+#define TEMPERATURE_H_
+
+#include "type.h"
+
+// Periods averaged per reading (about 190 ms at room temperature)
+#ifndef TEMPERATURE_WINDOW
+#define TEMPERATURE_WINDOW			64
+#endif
+
+// Sensor period per kelvin over 10 us, set by the TS0/TS1 straps (10 us/K
+// on the base board), as TEMP_SCALAR_DIV10 in the board library
+#ifndef TEMPERATURE_SCALAR_DIV10
+#define TEMPERATURE_SCALAR_DIV10	1
+#endif
+
+// Call after temp_init(), which sets up the pin.
+void temperature_init(void);
+
+// True once the first window has completed.
+uint8_t temperature_ready(void);
+
+// Latest window average in 0.1 C, the scale of temp_read(). Until the first
+// window completes this falls back to the blocking temp_read().
+int32_t temperature_read(void);
+
+// Windows completed so far; changes whenever a new reading is available.
+uint32_t temperature_count(void);
+
+#endif /* TEMPERATURE_H_ */
@@ -50,7 +50,7 @@
 * patent rights of the copyright holder.
 **************************************************************************/
 #include "../include/bmp180.h"
-static struct bmp180_t *p_bmp180;
+#include "../include/decimate.h"
 
 /*!
  *	@brief This function is used for initialize
@@ -58,7 +58,7 @@ static struct bmp180_t *p_bmp180;
  *  and assign the chip id and I2C address of the BMP180
  *	chip id is read in the register 0xD0 bit from 0 to 7
  *
- *	 @param bmp180 structure pointer.
+ *	 @param p_bmp180 structure pointer.
  *
  *	@note While changing the parameter of the bmp180_t
  *	@note consider the following point:
@@ -77,20 +77,21 @@ static struct bmp180_t *p_bmp180;
  *
  *
 */
-BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180)
+BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *p_bmp180)
 {
 	/* used to return the bus communication results*/
 	BMP180_RETURN_FUNCTION_TYPE v_com_rslt_s8 = E_BMP_COMM_RES;
 	u8 v_data_u8 = BMP180_INIT_VALUE;
-	/* assign BMP180 ptr */
-	p_bmp180 = bmp180;
+	/* check the p_bmp180 structure pointer as NULL*/
+	if (p_bmp180 == BMP180_NULL)
+		return E_BMP_NULL_PTR;
 	/* read Chip Id */
 	v_com_rslt_s8 = p_bmp180->BMP180_BUS_READ_FUNC(
 	p_bmp180->dev_addr, BMP180_CHIP_ID__REG,
 	&v_data_u8, BMP180_GEN_READ_WRITE_DATA_LENGTH);
 	p_bmp180->chip_id = BMP180_GET_BITSLICE(v_data_u8, BMP180_CHIP_ID);
 	p_bmp180->number_of_samples = BMP180_INITIALIZE_NUMBER_OF_SAMPLES_U8X;
-	p_bmp180->oversamp_setting = BMP180_INITIALIZE_OVERSAMP_SETTING_U8X;
+	p_bmp180->oversamp_setting = BMP180_INITIALIZE_OSS;
 	p_bmp180->sw_oversamp = BMP180_INITIALIZE_SW_OVERSAMP_U8X;
 	v_com_rslt_s8 += p_bmp180->BMP180_BUS_READ_FUNC(
 	p_bmp180->dev_addr, BMP180_VERSION_REG,
@@ -101,7 +102,7 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180)
 	v_data_u8, BMP180_ML_VERSION);/* get ML Version */
 	p_bmp180->al_version = BMP180_GET_BITSLICE(
 	v_data_u8, BMP180_AL_VERSION); /* get AL Version */
-	v_com_rslt_s8 += bmp180_get_calib_param();
+	v_com_rslt_s8 += bmp180_get_calib_param(p_bmp180);
 
 	return v_com_rslt_s8;
 }
@@ -123,6 +124,7 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180)
  *		MC     |  0xBC   | 0xBD    | 0 to 7
  *		MD     | 0xBE    | 0xBF    | 0 to 7
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
@@ -130,7 +132,8 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_init(struct bmp180_t *bmp180)
  *
  *
 */
-BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(void)
+BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(
+struct bmp180_t *p_bmp180)
 {
 	/* used to return the bus communication results*/
 	BMP180_RETURN_FUNCTION_TYPE v_com_rslt_s8 = E_BMP_COMM_RES;
@@ -147,6 +150,9 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(void)
 	BMP180_INIT_VALUE, BMP180_INIT_VALUE,
 	BMP180_INIT_VALUE, BMP180_INIT_VALUE,
 	BMP180_INIT_VALUE, BMP180_INIT_VALUE};
+	/* check the p_bmp180 structure pointer as NULL*/
+	if (p_bmp180 == BMP180_NULL)
+		return E_BMP_NULL_PTR;
 	/* read calibration data*/
 	v_com_rslt_s8 = p_bmp180->BMP180_BUS_READ_FUNC(
 	p_bmp180->dev_addr, BMP180_PROM_START__ADDR,
@@ -208,6 +214,7 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(void)
  *	temperature using the uncompensated temperature(ut)
  *	@note For reading the ut data refer : bmp180_read_ut()
  *
+ *	@param p_bmp180 structure pointer.
  *	@param v_uncomp_temperature_u32:
  *	the value of uncompensated temperature
  *
@@ -215,7 +222,8 @@ BMP180_RETURN_FUNCTION_TYPE bmp180_get_calib_param(void)
  *
  *
 */
-s16 bmp180_get_temperature(u32 v_uncomp_temperature_u32)
+RAMFUNC s16 bmp180_get_temperature(struct bmp180_t *p_bmp180,
+u32 v_uncomp_temperature_u32)
 {
 	s16 v_temperature_s16 = BMP180_INIT_VALUE;
 	s32 v_x1_s32, v_x2_s32 = BMP180_INIT_VALUE;
@@ -244,12 +252,14 @@ s16 bmp180_get_temperature(u32 v_uncomp_temperature_u32)
  *	pressure using the uncompensated pressure(up)
  *	@note For reading the up data refer : bmp180_read_up()
  *
+ *	@param p_bmp180 structure pointer.
  *	@param v_uncomp_pressure_u32: the value of uncompensated pressure
  *
  *	@return Return the value of pressure in steps of 1.0 Pa
  *
 */
-s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32)
+RAMFUNC s32 bmp180_get_pressure(struct bmp180_t *p_bmp180,
+u32 v_uncomp_pressure_u32)
 {
 	s32 v_pressure_s32, v_x1_s32, v_x2_s32,
 	v_x3_s32, v_b3_s32, v_b6_s32 = BMP180_INIT_VALUE;
@@ -267,7 +277,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32)
 
 	v_x3_s32 = v_x1_s32 + v_x2_s32;
 	v_b3_s32 = (((((s32)p_bmp180->calib_param.ac1)*4 + v_x3_s32) <<
-	p_bmp180->oversamp_setting) + 2)
+	BMP180_OSS(p_bmp180)) + 2)
 	>> BMP180_SHIFT_BIT_POSITION_BY_02_BITS;
 
 	/*****calculate B4************/
@@ -282,7 +292,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32)
 	(v_x3_s32 + 32768)) >> BMP180_SHIFT_BIT_POSITION_BY_15_BITS;
 
 	v_b7_u32 = ((u32)(v_uncomp_pressure_u32 - v_b3_s32) *
-	(50000 >> p_bmp180->oversamp_setting));
+	(50000 >> BMP180_OSS(p_bmp180)));
 	if (v_b7_u32 < 0x80000000) {
 		if (v_b4_u32 != BMP180_CHECK_DIVISOR)
 			v_pressure_s32 =
@@ -317,6 +327,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32)
  *	@note 0xF6(MSB) bit from 0 to 7
  *	@note 0xF7(LSB) bit from 0 to 7
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
@@ -324,7 +335,7 @@ s32 bmp180_get_pressure(u32 v_uncomp_pressure_u32)
  *
  *
 */
-u16 bmp180_get_uncomp_temperature(void)
+u16 bmp180_get_uncomp_temperature(struct bmp180_t *p_bmp180)
 {
 	u16 v_ut_u16 = BMP180_INIT_VALUE;
 	/* Array holding the temperature LSB and MSB data*/
@@ -358,17 +369,21 @@ u16 bmp180_get_uncomp_temperature(void)
  *	@note 0xF6(MSB) bit from 0 to 7
  *	@note 0xF7(LSB) bit from 0 to 7
  *	@note 0xF8(LSB) bit from 3 to 7
+ *	@note With sw_oversamp set, runs 2^oversamp_setting OSS 0
+ *	conversions back to back and sums them (see decimate.h)
+ *	instead of one hardware-oversampled conversion
  *
+ *	@param p_bmp180 structure pointer.
  *
  *	@return results of bus communication function
  *	@retval 0 -> Success
  *	@retval -1 -> Error
  *
 */
-u32 bmp180_get_uncomp_pressure(void)
+u32 bmp180_get_uncomp_pressure(struct bmp180_t *p_bmp180)
 {
-	/*j included for loop*/
-	u8 v_j_u8 = BMP180_INIT_VALUE;
+	/*software oversampling filter*/
+	struct decimate v_decimate;
 	u32 v_up_u32 = BMP180_INIT_VALUE;
 	/*get the calculated pressure data*/
 	u32 v_sum_u32 = BMP180_INIT_VALUE;
@@ -380,20 +395,21 @@ u32 bmp180_get_uncomp_pressure(void)
 	BMP180_RETURN_FUNCTION_TYPE v_com_rslt_s8 = E_BMP_COMM_RES;
 
 	if (p_bmp180->sw_oversamp == BMP180_SW_OVERSAMP_U8X &&
-	p_bmp180->oversamp_setting == BMP180_OVERSAMP_SETTING_U8X) {
-		for (v_j_u8 = BMP180_INIT_VALUE;
-		v_j_u8 < BMP180_DATA_MEASURE; v_j_u8++) {
-			/* 3 times getting pressure data*/
-			v_ctrl_reg_data_u8 = BMP180_P_MEASURE +
-			(p_bmp180->oversamp_setting
-			<< BMP180_SHIFT_BIT_POSITION_BY_06_BITS);
+	BMP180_OSS(p_bmp180) <= BMP180_OVERSAMP_SETTING_U8X) {
+		/* 2^oversamp_setting back-to-back conversions at OSS 0,
+		summed without dividing: the decimated up lands on the
+		oversamp_setting scale, so bmp180_get_pressure needs
+		no change */
+		decimate_init(&v_decimate, BMP180_OSS(p_bmp180),
+		BMP180_INIT_VALUE);
+		do {
+			v_ctrl_reg_data_u8 = BMP180_P_MEASURE;
 			v_com_rslt_s8 = p_bmp180->BMP180_BUS_WRITE_FUNC(
 			p_bmp180->dev_addr,
 			BMP180_CTRL_MEAS_REG,
 			&v_ctrl_reg_data_u8, BMP180_GEN_READ_WRITE_DATA_LENGTH);
-			p_bmp180->delay_msec(BMP180_2MS_DELAY_U8X + (
-			BMP180_3MS_DELAY_U8X <<
-			(p_bmp180->oversamp_setting)));
+			p_bmp180->delay_msec(BMP180_2MS_DELAY_U8X +
+			BMP180_3MS_DELAY_U8X);
 			v_com_rslt_s8 +=
 			p_bmp180->BMP180_BUS_READ_FUNC(
 			p_bmp180->dev_addr,
@@ -405,27 +421,22 @@ u32 bmp180_get_uncomp_pressure(void)
 			((u32) v_data_u8[BMP180_PRESSURE_LSB_DATA]
 			<< BMP180_SHIFT_BIT_POSITION_BY_08_BITS) |
 			(u32) v_data_u8[BMP180_PRESSURE_XLSB_DATA]) >>
-			(BMP180_CALCULATE_TRUE_PRESSURE -
-			p_bmp180->oversamp_setting));
-			p_bmp180->number_of_samples =
-			BMP180_INITIALIZE_NUMBER_OF_SAMPLES_U8X;
-
-			v_up_u32 = v_up_u32 + v_sum_u32;
-			/*add up with dummy var*/
-		}
-		v_up_u32 = v_up_u32 / BMP180_AVERAGE_U8X; /*averaging*/
+			BMP180_CALCULATE_TRUE_PRESSURE);
+		} while (!decimate_push(&v_decimate, v_sum_u32, &v_up_u32));
+		p_bmp180->number_of_samples =
+		(s32)1 << BMP180_OSS(p_bmp180);
 	} else {
 		if (p_bmp180->sw_oversamp ==
 		BMP180_INITIALIZE_SW_OVERSAMP_U8X) {
 			v_ctrl_reg_data_u8 = BMP180_P_MEASURE +
-			(p_bmp180->oversamp_setting
+			(BMP180_OSS(p_bmp180)
 			<< BMP180_SHIFT_BIT_POSITION_BY_06_BITS);
 			v_com_rslt_s8 = p_bmp180->BMP180_BUS_WRITE_FUNC(
 			p_bmp180->dev_addr, BMP180_CTRL_MEAS_REG,
 			&v_ctrl_reg_data_u8, BMP180_GEN_READ_WRITE_DATA_LENGTH);
 			p_bmp180->delay_msec(BMP180_2MS_DELAY_U8X
 			+ (BMP180_3MS_DELAY_U8X <<
-			(p_bmp180->oversamp_setting)));
+			(BMP180_OSS(p_bmp180))));
 			v_com_rslt_s8 += p_bmp180->BMP180_BUS_READ_FUNC(
 			p_bmp180->dev_addr,
 			BMP180_ADC_OUT_MSB_REG,
@@ -437,7 +448,7 @@ u32 bmp180_get_uncomp_pressure(void)
 			<< BMP180_SHIFT_BIT_POSITION_BY_08_BITS) |
 			(u32) v_data_u8[BMP180_PRESSURE_XLSB_DATA]) >>
 			(BMP180_CALCULATE_TRUE_PRESSURE -
-			p_bmp180->oversamp_setting));
+			BMP180_OSS(p_bmp180)));
 			p_bmp180->number_of_samples =
 			BMP180_INITIALIZE_NUMBER_OF_SAMPLES_U8X;
 		}
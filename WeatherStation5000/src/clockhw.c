@@ -0,0 +1,96 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "../include/clockmgr.h"
+
+// MAINCLKSEL sources
+#define MAINCLK_IRC			0
+#define MAINCLK_PLL_OUT		3
+
+// Flash access time, FLASHCFG bits 1:0: system clocks per access minus
+// one; one clock up to 20 MHz, two up to 40 MHz, three above
+#define FLASHCFG			(*(volatile uint32_t *)0x4003C010)
+#define FLASHCFG_TIM_MASK	0x3
+#define FLASH_1CLK_HZ		20000000
+#define FLASH_2CLK_HZ		40000000
+
+#define UART_LCR_DLAB		0x80
+#define UART_LSR_TEMT		0x40
+
+// Below this many SysTick counts the rest of the millisecond is dropped
+#define SYSTICK_MIN_REST	16
+
+static void set_flash_time(uint32_t hz)
+{
+	uint32_t tim = (hz <= FLASH_1CLK_HZ) ? 0 : (hz <= FLASH_2CLK_HZ) ? 1 : 2;
+
+	FLASHCFG = (FLASHCFG & ~FLASHCFG_TIM_MASK) | tim;
+}
+
+static void set_main_clock(uint32_t source)
+{
+	LPC_SYSCON->MAINCLKSEL = source;
+	LPC_SYSCON->MAINCLKUEN = 0;
+	LPC_SYSCON->MAINCLKUEN = 1;
+	while (!(LPC_SYSCON->MAINCLKUEN & 1))
+		;
+}
+
+// The counter keeps its place in the millisecond: the rest of it, scaled
+// to the new clock, is loaded once before the new reload value
+static void set_systick(uint32_t oldHz, uint32_t hz)
+{
+	uint32_t rest = SysTick->VAL / (oldHz / 1000000) * (hz / 1000000);
+
+	if (rest >= SYSTICK_MIN_REST)
+	{
+		SysTick->LOAD = rest;
+		SysTick->VAL = 0;
+		while (SysTick->VAL == 0)
+			;
+	}
+	SysTick->LOAD = hz / 1000 - 1;
+}
+
+static void set_uart(uint32_t hz, uint32_t baud)
+{
+	uint8_t fdr;
+	uint16_t dl = clock_uart_divisor(hz / LPC_SYSCON->UARTCLKDIV, baud, &fdr);
+	uint32_t lcr = LPC_UART->LCR;
+
+	LPC_UART->LCR = lcr | UART_LCR_DLAB;
+	LPC_UART->DLM = dl >> 8;
+	LPC_UART->DLL = dl & 0xFF;
+	LPC_UART->LCR = lcr & ~UART_LCR_DLAB;
+	LPC_UART->FDR = fdr;
+}
+
+void clock_hw_set(uint8_t mode, uint32_t hz, uint32_t uartBaud)
+{
+	uint32_t oldHz = SystemCoreClock;
+
+	// Let the UART finish the character it is shifting out
+	while (!(LPC_UART->LSR & UART_LSR_TEMT))
+		;
+
+	__disable_irq();
+	if (hz > oldHz)
+		set_flash_time(hz);
+	set_main_clock((mode == CLOCK_FAST) ? MAINCLK_PLL_OUT : MAINCLK_IRC);
+	if (hz < oldHz)
+		set_flash_time(hz);
+
+	SystemCoreClock = hz;
+	set_systick(oldHz, hz);
+	set_uart(hz, uartBaud);
+	LPC_I2C->SCLH = hz / (2 * CLOCK_I2C_HZ);
+	LPC_I2C->SCLL = hz / (2 * CLOCK_I2C_HZ);
+	__enable_irq();
+}
+
+uint32_t clock_hw_us(void)
+{
+	uint32_t load = SysTick->LOAD;
+
+	// SysTick counts down from LOAD once a millisecond
+	return (load - SysTick->VAL) * 1000 / (load + 1);
+}
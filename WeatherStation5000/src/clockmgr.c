@@ -0,0 +1,137 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "timer32.h"
+#include "../include/clockmgr.h"
+#include "../include/ramfunc.h"
+#include "../include/record.h"
+
+static uint32_t pllHz = 0;
+static uint32_t baud = 0;
+static uint8_t mode = CLOCK_FAST;
+static uint8_t fastDepth = 0;
+static uint32_t switches = 0;
+static uint32_t releaseMs = 0;
+
+static clock_listener_t listeners[CLOCK_MAX_LISTENERS];
+static uint8_t listenerCount = 0;
+
+// Counted by SysTick
+static volatile uint32_t modeMs[CLOCK_MODES];
+
+static uint32_t now_ms(void)
+{
+	return modeMs[CLOCK_FAST] + modeMs[CLOCK_IDLE];
+}
+
+static void set_mode(uint8_t next)
+{
+	uint32_t hz;
+	uint8_t i;
+
+#ifdef CLOCK_FIXED
+	next = CLOCK_FAST;
+#endif
+	if (next == mode || pllHz == 0)
+		return;
+
+	hz = (next == CLOCK_FAST) ? pllHz : CLOCK_IRC_HZ;
+	clock_hw_set(next, hz, baud);
+	mode = next;
+	switches++;
+	for (i = 0; i < listenerCount; i++)
+		listeners[i](hz);
+}
+
+void clock_init(uint32_t uartBaud)
+{
+	baud = uartBaud;
+	pllHz = SystemCoreClock;
+	mode = CLOCK_FAST;
+	fastDepth = 0;
+	switches = 0;
+	modeMs[CLOCK_FAST] = 0;
+	modeMs[CLOCK_IDLE] = 0;
+	set_mode(CLOCK_IDLE);
+}
+
+void clock_attach(clock_listener_t listener)
+{
+	if (listenerCount < CLOCK_MAX_LISTENERS)
+		listeners[listenerCount++] = listener;
+}
+
+void clock_fast(void)
+{
+	if (fastDepth++ == 0)
+		set_mode(CLOCK_FAST);
+}
+
+// The drop to the IRC waits for clock_settle()
+void clock_release(void)
+{
+	if (fastDepth > 0 && --fastDepth == 0)
+		releaseMs = now_ms();
+}
+
+uint32_t clock_hold_ms(void)
+{
+	uint32_t held = now_ms() - releaseMs;
+
+	if (fastDepth > 0 || mode == CLOCK_IDLE || held >= CLOCK_HOLD_MS)
+		return 0;
+	return CLOCK_HOLD_MS - held;
+}
+
+void clock_settle(void)
+{
+	if (fastDepth == 0 && mode == CLOCK_FAST
+		&& record_u8(REC_CLOCK, now_ms() - releaseMs >= CLOCK_HOLD_MS))
+		set_mode(CLOCK_IDLE);
+}
+
+void clock_delay_ms(uint32_t ms)
+{
+	// Not worth two switches
+	if (ms < CLOCK_HOLD_MS)
+	{
+		delay32Ms(0, ms);
+		return;
+	}
+	set_mode(CLOCK_IDLE);
+	delay32Ms(0, ms);
+	if (fastDepth > 0)
+		set_mode(CLOCK_FAST);
+}
+
+uint8_t clock_mode(void)
+{
+	return mode;
+}
+
+RAMFUNC void clock_tick(void)
+{
+	modeMs[mode]++;
+}
+
+uint32_t clock_ms(uint8_t m)
+{
+	return (m < CLOCK_MODES) ? modeMs[m] : 0;
+}
+
+uint32_t clock_switches(void)
+{
+	return switches;
+}
+
+uint32_t clock_us(void)
+{
+	uint32_t ms, us;
+
+	// Again if SysTick moved on in between
+	do
+	{
+		ms = now_ms();
+		us = clock_hw_us();
+	} while (ms != now_ms());
+	return ms * 1000 + us;
+}
@@ -49,6 +49,8 @@ extern "C" {
 #include "system_LPC13xx.h"
 #endif
 
+#include "../include/stackmon.h"
+
 //*****************************************************************************
 #if defined (__cplusplus)
 extern "C" {
@@ -234,6 +236,16 @@ extern unsigned long _edata;
 extern unsigned long _bss;
 extern unsigned long _ebss;
 
+//*****************************************************************************
+//
+// The RAM functions (ramfunc.ld): where they run and where their code is
+// loaded in flash.
+//
+//*****************************************************************************
+extern unsigned long _ramfunc_load;
+extern unsigned long _ramfunc;
+extern unsigned long _eramfunc;
+
 //*****************************************************************************
 //
 // This is the code that gets called when the processor first starts execution
@@ -256,6 +268,14 @@ ResetISR(void) {
 		*pulDest++ = *pulSrc++;
 	}
 
+	//
+	// Copy the RAM functions from flash the same way.
+	//
+	pulSrc = &_ramfunc_load;
+	for (pulDest = &_ramfunc; pulDest < &_eramfunc;) {
+		*pulDest++ = *pulSrc++;
+	}
+
 	//
 	// Zero fill the bss segment.  This is done with inline assembly since this
 	// will clear the value of pulDest if it is not kept in a register.
@@ -270,6 +290,11 @@ ResetISR(void) {
 			"        strlt   r2, [r0], #4\n"
 			"        blt     zero_loop");
 
+	//
+	// Paint the free RAM below the stack for the high-water mark.
+	//
+	stackmon_paint();
+
 #ifdef __USE_CMSIS
 	SystemInit();
 #endif
@@ -0,0 +1,76 @@
+#include "type.h"
+#include "../include/clockmgr.h"
+#include "../include/energy.h"
+#include "../include/i2csched.h"
+
+// Start, stop and 8 data bits
+#define UART_BITS_PER_BYTE	10
+
+static uint32_t baud = 0;
+
+// Added up since the last energy_take()
+static uint32_t addedUs[ENERGY_SUBSYSTEMS];
+
+// Sources that keep their own totals, as of the last energy_take()
+static uint32_t lastModeMs[CLOCK_MODES];
+static uint32_t lastBusBytes;
+
+static void mark(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		addedUs[i] = 0;
+	for (i = 0; i < CLOCK_MODES; i++)
+		lastModeMs[i] = clock_ms(i);
+	lastBusBytes = i2csched_bytes();
+}
+
+void energy_init(uint32_t uartBaud)
+{
+	baud = uartBaud;
+	mark();
+}
+
+void energy_add_us(uint8_t subsystem, uint32_t us)
+{
+	addedUs[subsystem] += us;
+}
+
+void energy_add_uart(uint32_t bytes)
+{
+	if (baud != 0)
+		addedUs[ENERGY_UART] += (uint32_t)((uint64_t)bytes * UART_BITS_PER_BYTE * 1000000 / baud);
+}
+
+void energy_take(struct energy_report *pReport, uint32_t samples)
+{
+	uint32_t us[ENERGY_SUBSYSTEMS];
+	uint32_t fastMs = clock_ms(CLOCK_FAST) - lastModeMs[CLOCK_FAST];
+	uint32_t idleMs = clock_ms(CLOCK_IDLE) - lastModeMs[CLOCK_IDLE];
+	uint32_t intervalMs = fastMs + idleMs;
+	uint64_t uj, total = 0;
+	uint8_t i;
+
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		us[i] = addedUs[i];
+	us[ENERGY_BOARD] = intervalMs * 1000;
+	us[ENERGY_CPU_FAST] = fastMs * 1000;
+	us[ENERGY_CPU_IDLE] = idleMs * 1000;
+	// All bus traffic, not only the scheduled runs' (burst mode reads
+	// outside them)
+	us[ENERGY_I2C] = I2CSCHED_BYTE_US(i2csched_bytes() - lastBusBytes);
+
+	// uJ per ms is mW
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+	{
+		uj = energy_uj(i, us[i]);
+		total += uj;
+		pReport->uw[i] = (intervalMs > 0) ? (uint32_t)(uj * 1000 / intervalMs) : 0;
+	}
+	pReport->intervalMs = intervalMs;
+	pReport->perSampleUj = (samples > 0) ? (uint32_t)(total / samples) : 0;
+	pReport->perHourUwh = (intervalMs > 0) ? (uint32_t)(total * 1000 / intervalMs) : 0;
+
+	mark();
+}
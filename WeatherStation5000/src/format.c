@@ -0,0 +1,75 @@
+#include "type.h"
+#include "stdio.h"
+#include "string.h"
+#include "../include/format.h"
+
+void intToString(int value, uint8_t* pBuf, uint32_t len, uint32_t base)
+{
+    static const char* pAscii = "0123456789abcdefghijklmnopqrstuvwxyz";
+    int pos = 0;
+    int tmpValue = value;
+
+    // the buffer must not be null and at least have a length of 2 to handle one
+    // digit and null-terminator
+    if (pBuf == NULL || len < 2)
+    {
+        return;
+    }
+
+    // a valid base cannot be less than 2 or larger than 36
+    // a base value of 2 means binary representation. A value of 1 would mean only zeros
+    // a base larger than 36 can only be used if a larger alphabet were used.
+    if (base < 2 || base > 36)
+    {
+        return;
+    }
+
+    // negative value
+    if (value < 0)
+    {
+        tmpValue = -tmpValue;
+        value    = -value;
+        pBuf[pos++] = '-';
+    }
+
+    // calculate the required length of the buffer
+    do {
+        pos++;
+        tmpValue /= base;
+    } while(tmpValue > 0);
+
+
+    if (pos > len)
+    {
+        // the len parameter is invalid.
+        return;
+    }
+
+    pBuf[pos] = '\0';
+
+    do {
+        pBuf[--pos] = pAscii[value % base];
+        value /= base;
+    } while(value > 0);
+
+    return;
+
+}
+
+void snapshot_encode(char *pBuf, int32_t temp, uint32_t lux, const uint8_t *pPressure)
+{
+	memset(pBuf, 0, SNAPSHOT_SIZE);
+	sprintf(pBuf, "765;%d;%d;%s;", temp, lux, pPressure); //765 as control number
+}
+
+uint8_t snapshot_decode(const char *pBuf, int32_t *pTemp, uint32_t *pLux, int32_t *pPressure)
+{
+	if ( pBuf[0] != '7' || pBuf[1] != '6' || pBuf[2] != '5' )
+		return 0;
+
+	*pTemp = 0;
+	*pLux = 0;
+	*pPressure = 0;
+	sscanf(pBuf, "765;%d;%d;%d;", pTemp, pLux, pPressure);
+	return 1;
+}
@@ -0,0 +1,130 @@
+#include "../include/frame.h"
+
+enum {
+	STATE_SYNC0 = 0,
+	STATE_SYNC1,
+	STATE_TYPE,
+	STATE_LEN,
+	STATE_PAYLOAD,
+	STATE_CRC
+};
+
+uint8_t frame_crc8(uint8_t crc, const uint8_t *pData, uint32_t len)
+{
+	uint32_t i;
+	uint8_t bit;
+
+	for (i = 0; i < len; i++)
+	{
+		crc ^= pData[i];
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+
+	return crc;
+}
+
+uint8_t frame_encode(uint8_t *pOut, uint8_t type, const uint8_t *pPayload, uint8_t len)
+{
+	uint8_t i;
+
+	if (len > FRAME_MAX_PAYLOAD)
+		return 0;
+
+	pOut[0] = FRAME_SYNC0;
+	pOut[1] = FRAME_SYNC1;
+	pOut[2] = type;
+	pOut[3] = len;
+	for (i = 0; i < len; i++)
+		pOut[FRAME_HEADER_SIZE + i] = pPayload[i];
+	pOut[FRAME_HEADER_SIZE + len] = frame_crc8(0, &pOut[2], (uint32_t)len + 2);
+
+	return FRAME_HEADER_SIZE + len + 1;
+}
+
+void frame_decoder_init(struct frame_decoder *pDec)
+{
+	pDec->state = STATE_SYNC0;
+	pDec->type = 0;
+	pDec->len = 0;
+	pDec->pos = 0;
+	pDec->crc = 0;
+}
+
+int8_t frame_decoder_feed(struct frame_decoder *pDec, uint8_t byte)
+{
+	switch (pDec->state)
+	{
+	case STATE_SYNC0:
+		if (byte == FRAME_SYNC0)
+			pDec->state = STATE_SYNC1;
+		break;
+
+	case STATE_SYNC1:
+		if (byte == FRAME_SYNC1)
+			pDec->state = STATE_TYPE;
+		else if (byte != FRAME_SYNC0)
+			pDec->state = STATE_SYNC0;
+		break;
+
+	case STATE_TYPE:
+		pDec->type = byte;
+		pDec->crc = frame_crc8(0, &byte, 1);
+		pDec->state = STATE_LEN;
+		break;
+
+	case STATE_LEN:
+		if (byte > FRAME_MAX_PAYLOAD)
+		{
+			pDec->state = STATE_SYNC0;
+			return FRAME_ERROR;
+		}
+		pDec->len = byte;
+		pDec->pos = 0;
+		pDec->crc = frame_crc8(pDec->crc, &byte, 1);
+		pDec->state = (byte == 0) ? STATE_CRC : STATE_PAYLOAD;
+		break;
+
+	case STATE_PAYLOAD:
+		pDec->payload[pDec->pos++] = byte;
+		pDec->crc = frame_crc8(pDec->crc, &byte, 1);
+		if (pDec->pos == pDec->len)
+			pDec->state = STATE_CRC;
+		break;
+
+	case STATE_CRC:
+		pDec->state = STATE_SYNC0;
+		return (byte == pDec->crc) ? FRAME_READY : FRAME_ERROR;
+
+	default:
+		pDec->state = STATE_SYNC0;
+		break;
+	}
+
+	return FRAME_NONE;
+}
+
+void frame_put_u16(uint8_t *pBuf, uint16_t value)
+{
+	pBuf[0] = (uint8_t)value;
+	pBuf[1] = (uint8_t)(value >> 8);
+}
+
+void frame_put_u32(uint8_t *pBuf, uint32_t value)
+{
+	pBuf[0] = (uint8_t)value;
+	pBuf[1] = (uint8_t)(value >> 8);
+	pBuf[2] = (uint8_t)(value >> 16);
+	pBuf[3] = (uint8_t)(value >> 24);
+}
+
+uint16_t frame_get_u16(const uint8_t *pBuf)
+{
+	return (uint16_t)(pBuf[0] | (pBuf[1] << 8));
+}
+
+uint32_t frame_get_u32(const uint8_t *pBuf)
+{
+	return (uint32_t)pBuf[0] | ((uint32_t)pBuf[1] << 8)
+		| ((uint32_t)pBuf[2] << 16) | ((uint32_t)pBuf[3] << 24);
+}
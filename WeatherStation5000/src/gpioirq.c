@@ -0,0 +1,75 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "../include/gpioirq.h"
+
+struct gpioirq_slot {
+	uint32_t mask;
+	gpioirq_handler_t handler;
+};
+
+static LPC_GPIO_TypeDef * const ports[4] = {
+	LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3
+};
+
+static const IRQn_Type portIrqs[4] = {
+	EINT0_IRQn, EINT1_IRQn, EINT2_IRQn, EINT3_IRQn
+};
+
+static struct gpioirq_slot slots[4][GPIOIRQ_MAX_HANDLERS];
+
+static void dispatch(uint8_t port)
+{
+	LPC_GPIO_TypeDef *pGpio = ports[port];
+	uint32_t pending = pGpio->MIS;
+	uint32_t level;
+	uint8_t i;
+
+	pGpio->IC = pending;
+	level = pGpio->DATA;
+	for (i = 0; i < GPIOIRQ_MAX_HANDLERS; i++)
+	{
+		if (slots[port][i].handler != NULL && (pending & slots[port][i].mask) != 0)
+			slots[port][i].handler(pending & slots[port][i].mask, level);
+	}
+}
+
+void PIOINT0_IRQHandler(void) { dispatch(0); }
+void PIOINT1_IRQHandler(void) { dispatch(1); }
+void PIOINT2_IRQHandler(void) { dispatch(2); }
+void PIOINT3_IRQHandler(void) { dispatch(3); }
+
+uint8_t gpioirq_attach(uint8_t port, uint32_t mask, uint8_t edges, gpioirq_handler_t handler)
+{
+	LPC_GPIO_TypeDef *pGpio;
+	uint8_t i;
+
+	if (port > 3)
+		return 0;
+	for (i = 0; i < GPIOIRQ_MAX_HANDLERS; i++)
+		if (slots[port][i].handler == NULL)
+			break;
+	if (i == GPIOIRQ_MAX_HANDLERS)
+		return 0;
+
+	slots[port][i].mask = mask;
+	slots[port][i].handler = handler;
+
+	pGpio = ports[port];
+	pGpio->IS &= ~mask;
+	if (edges == GPIOIRQ_BOTH)
+		pGpio->IBE |= mask;
+	else
+	{
+		pGpio->IBE &= ~mask;
+		if (edges == GPIOIRQ_RISING)
+			pGpio->IEV |= mask;
+		else
+			pGpio->IEV &= ~mask;
+	}
+	pGpio->IC = mask;
+	pGpio->IE |= mask;
+
+	NVIC_SetPriority(portIrqs[port], GPIOIRQ_PRIORITY);
+	NVIC_EnableIRQ(portIrqs[port]);
+	return 1;
+}
@@ -0,0 +1,120 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "i2c.h"
+#include "../include/clockmgr.h"
+#include "../include/i2csched.h"
+#include "../include/metrics.h"
+#include "../include/record.h"
+
+static uint32_t busBytes = 0;
+static struct i2csched_stats stats;
+
+// Runs a transaction, again up to I2CSCHED_RETRIES times if it fails.
+// Returns the status of the last attempt.
+static Status transfer(Status (*pXfer)(uint32_t, uint8_t *, uint32_t), uint8_t addr,
+	uint8_t *pBuf, uint8_t len)
+{
+	uint8_t attempt;
+
+	for (attempt = 0; ; attempt++)
+	{
+		busBytes += len + 1;
+		if (record_u8(REC_BUS, pXfer(addr, pBuf, len) == SUCCESS))
+			return SUCCESS;
+		metrics_add(METRIC_I2C_ERRORS, 1);
+		if (attempt == I2CSCHED_RETRIES)
+			return ERROR;
+		metrics_add(METRIC_I2C_RETRIES, 1);
+	}
+}
+
+Status i2csched_write(uint8_t addr, uint8_t *pBuf, uint8_t len)
+{
+	return transfer(I2CWrite, addr, pBuf, len);
+}
+
+Status i2csched_read(uint8_t addr, uint8_t *pBuf, uint8_t len)
+{
+	return transfer(I2CRead, addr, pBuf, len);
+}
+
+void i2csched_account(uint32_t bytes)
+{
+	busBytes += bytes;
+}
+
+uint32_t i2csched_bytes(void)
+{
+	return busBytes;
+}
+
+uint32_t i2csched_run(struct i2csched_job *pJobs, uint8_t count)
+{
+	// The run keeps its own clock, advanced by the estimated bus time and
+	// by the sleeps. Real time only runs ahead of it, so a device is never
+	// addressed before its latency has passed.
+	uint32_t now = 0;
+	uint8_t pending = count;
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		pJobs[i].readyUs = 0;
+		pJobs[i].done = 0;
+	}
+
+	while (pending > 0)
+	{
+		struct i2csched_job *pNext = NULL;
+		uint32_t before, busUs;
+		int32_t wait;
+
+		for (i = 0; i < count; i++)
+		{
+			if (!pJobs[i].done && (pNext == NULL || pJobs[i].readyUs < pNext->readyUs))
+				pNext = &pJobs[i];
+		}
+
+		// Every device is busy
+		if (pNext->readyUs > now)
+		{
+			uint32_t ms = (pNext->readyUs - now + 999) / 1000;
+			clock_delay_ms(ms);
+			now += ms * 1000;
+		}
+
+		before = busBytes;
+		wait = pNext->step(pNext->pCtx);
+		busUs = I2CSCHED_BYTE_US(busBytes - before);
+		now += busUs;
+		stats.busUs += busUs;
+		stats.serialUs += busUs;
+
+		if (wait == I2CSCHED_DONE)
+		{
+			pNext->done = 1;
+			pending--;
+		}
+		else
+		{
+			pNext->readyUs = now + (uint32_t)wait * 1000;
+			stats.serialUs += (uint32_t)wait * 1000;
+		}
+	}
+
+	stats.runs++;
+	stats.elapsedUs += now;
+	return now;
+}
+
+void i2csched_get_stats(struct i2csched_stats *pStats)
+{
+	*pStats = stats;
+}
+
+uint8_t i2csched_utilisation(void)
+{
+	if (stats.elapsedUs == 0)
+		return 0;
+	return (uint8_t)((uint64_t)stats.busUs * 100 / stats.elapsedUs);
+}
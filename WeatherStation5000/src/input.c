@@ -0,0 +1,198 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "gpio.h"
+#include "../include/gpioirq.h"
+#include "../include/input.h"
+#include "../include/metrics.h"
+#include "../include/spsc.h"
+
+// Joystick lines on port 2, active low
+#define JOY_CENTER_BIT		0
+#define JOY_DOWN_BIT		1
+#define JOY_RIGHT_BIT		2
+#define JOY_UP_BIT			3
+#define JOY_LEFT_BIT		4
+#define JOY_MASK			0x1F
+
+#define BUTTON_BIT			1		// PIO0_1 (SW3), active low
+#define ROTARY_MASK			0x03	// PIO1_0 (A), PIO1_1 (B)
+
+// Keys: the joystick lines in bit order, then the button
+#define KEY_BUTTON			5
+#define KEYS				6
+
+static const uint8_t keyEvents[KEYS] = {
+	INPUT_CENTER, INPUT_DOWN, INPUT_RIGHT, INPUT_UP, INPUT_LEFT, INPUT_BUTTON
+};
+
+// Quadrature decode: index is (previous AB << 2) | current AB. Invalid
+// transitions (both lines changed) count as no movement.
+static const int8_t rotaryTable[16] = {
+	 0, -1,  1,  0,
+	 1,  0,  0, -1,
+	-1,  0,  0,  1,
+	 0,  1, -1,  0
+};
+
+static uint32_t (*pGetTicks)(void) = NULL;
+
+// Pushed by the GPIO interrupts only (one at a time, see gpioirq.h),
+// popped by the main loop only
+static uint8_t queueSlots[INPUT_QUEUE_SIZE];
+static struct spsc queue;
+static volatile uint32_t overflows = 0;
+static volatile uint32_t queuedMs = 0;	// push that made the queue non-empty
+static uint32_t eventMs = 0;			// queuedMs for the event last returned
+
+// Written by the GPIO handlers and input_tick(), which share a priority
+static uint32_t keyLastEdge[KEYS];
+static uint8_t keysArmed = 0;		// edge seen, level not yet sampled
+static uint8_t keysDown = 0;		// settled level, pressed
+static uint8_t rotaryState;
+static int8_t rotarySteps;
+
+static void push(uint8_t event)
+{
+	if (spsc_count(&queue) == 0)
+		queuedMs = pGetTicks();
+	if (spsc_push(&queue, &event, 1) == 0)
+	{
+		overflows++;
+		metrics_add(METRIC_INPUT_DROPPED, 1);
+	}
+}
+
+// Every edge restarts the key's window; its level is sampled once the
+// window has passed without one, so bounce on press or release is
+// swallowed whatever level it leaves at the edge.
+static void key_edge(uint8_t key)
+{
+	keyLastEdge[key] = pGetTicks();
+	keysArmed |= 1 << key;
+}
+
+// Pressed (active low) keys, as the pins read now
+static uint8_t keys_level(void)
+{
+	uint8_t down = ~LPC_GPIO2->DATA & JOY_MASK;
+
+	if ((LPC_GPIO0->DATA & (1 << BUTTON_BIT)) == 0)
+		down |= 1 << KEY_BUTTON;
+	return down;
+}
+
+static void settle(void)
+{
+	uint32_t now = pGetTicks();
+	uint8_t level = keys_level();
+	uint8_t key, bit;
+
+	for (key = 0; key < KEYS; key++)
+	{
+		bit = 1 << key;
+		if (!(keysArmed & bit) || (now - keyLastEdge[key]) < INPUT_DEBOUNCE_MS)
+			continue;
+		keysArmed &= ~bit;
+		if ((level & bit) && !(keysDown & bit))
+			push(keyEvents[key]);
+		keysDown = (keysDown & ~bit) | (level & bit);
+	}
+}
+
+static void button_isr(uint32_t pending, uint32_t level)
+{
+	key_edge(KEY_BUTTON);
+}
+
+static void rotary_isr(uint32_t pending, uint32_t level)
+{
+	uint8_t ab = level & ROTARY_MASK;
+
+	rotarySteps += rotaryTable[(rotaryState << 2) | ab];
+	rotaryState = ab;
+
+	if (rotarySteps >= INPUT_ROTARY_STEPS)
+	{
+		rotarySteps = 0;
+		push(INPUT_ROTARY_RIGHT);
+	}
+	else if (rotarySteps <= -INPUT_ROTARY_STEPS)
+	{
+		rotarySteps = 0;
+		push(INPUT_ROTARY_LEFT);
+	}
+}
+
+static void joystick_isr(uint32_t pending, uint32_t level)
+{
+	uint8_t bit;
+
+	for (bit = 0; bit < 5; bit++)
+	{
+		if (pending & (1 << bit))
+			key_edge(bit);
+	}
+}
+
+void input_init(uint32_t (*getMsTicks)(void))
+{
+	pGetTicks = getMsTicks;
+	spsc_init(&queue, queueSlots, 1, INPUT_QUEUE_SIZE);
+	rotaryState = LPC_GPIO1->DATA & ROTARY_MASK;
+	rotarySteps = 0;
+	keysArmed = 0;
+	keysDown = keys_level();
+
+	// input_tick() pushes too, so SysTick runs at the GPIO priority to
+	// keep a single writer on the queue
+	NVIC_SetPriority(SysTick_IRQn, GPIOIRQ_PRIORITY);
+
+	// Keys interrupt on both edges so every bounce restarts the debounce
+	// window; a press is told apart by the settled level. The encoder
+	// needs both edges of both lines.
+	gpioirq_attach(PORT0, (1 << BUTTON_BIT), GPIOIRQ_BOTH, button_isr);
+	gpioirq_attach(PORT1, ROTARY_MASK, GPIOIRQ_BOTH, rotary_isr);
+	gpioirq_attach(PORT2, JOY_MASK, GPIOIRQ_BOTH, joystick_isr);
+}
+
+RAMFUNC void input_tick(void)
+{
+	if (keysArmed != 0)
+		settle();
+}
+
+uint8_t input_get(void)
+{
+	uint8_t event;
+
+	// queuedMs only changes on an empty queue, so not before the pop
+	if (spsc_count(&queue) == 0)
+		return INPUT_NONE;
+	eventMs = queuedMs;
+	spsc_pop(&queue, &event, 1);
+	return event;
+}
+
+uint8_t input_pending(void)
+{
+	return spsc_count(&queue) != 0;
+}
+
+void input_wait(uint32_t ms)
+{
+	uint32_t start = pGetTicks();
+
+	// SysTick wakes the core every millisecond to re-check the time
+	while ((pGetTicks() - start) < ms && spsc_count(&queue) == 0)
+		__WFI();
+}
+
+uint32_t input_event_ms(void)
+{
+	return eventMs;
+}
+
+uint32_t input_overflows(void)
+{
+	return overflows;
+}
@@ -0,0 +1,27 @@
+#include "type.h"
+#include "../include/latency.h"
+
+static struct latency_hist hists[LATENCY_PATHS];
+
+void latency_record(uint8_t path, uint32_t ms)
+{
+	struct latency_hist *pHist = &hists[path];
+
+	pHist->counts[latency_bucket(ms)]++;
+	if (ms > pHist->maxMs)
+		pHist->maxMs = ms;
+}
+
+const struct latency_hist *latency_get(uint8_t path)
+{
+	return &hists[path];
+}
+
+void latency_clear(uint8_t path)
+{
+	uint8_t b;
+
+	for (b = 0; b < LATENCY_BUCKETS; b++)
+		hists[path].counts[b] = 0;
+	hists[path].maxMs = 0;
+}
@@ -8,6 +8,7 @@
 #include "type.h"
 #include "uart.h"
 #include "stdio.h"
+#include "string.h"
 #include "timer32.h"
 #include "i2c.h"
 #include "gpio.h"
@@ -21,80 +22,222 @@
 #include "temp.h"
 #include "joystick.h"
 #include "eeprom.h"
+#include "../include/clockmgr.h"
+#include "../include/energy.h"
+#include "../include/format.h"
+#include "../include/input.h"
+#include "../include/latency.h"
+#include "../include/metrics.h"
 #include "../include/pressure.h"
+#include "../include/rambench.h"
+#include "../include/ramfunc.h"
+#include "../include/record.h"
+#include "../include/samples.h"
+#include "../include/stackmon.h"
+#include "../include/telemetry.h"
+#include "../include/temperature.h"
 
 
 
-static uint32_t msTicks = 0;
+// Tick count at reset; host soak runs start it short of the 2^32 wrap
+#ifndef MS_TICKS_START
+#define MS_TICKS_START	0
+#endif
+
+static uint32_t msTicks = MS_TICKS_START;
 static uint8_t buf[10];
 static const uint32_t TOP_LEFT = 28;
 
+// Oldest sample the OLED accepts from the sample cache; the telemetry
+// takes the channels' adaptive periods (SAMPLE_PERIOD)
+#define DISPLAY_MAX_AGE_MS		500
+
+#define UART_BAUD				115200
+
+// Diagnostics page: a metric a row, scrolled with the joystick up/down
+#define DIAG_ROWS				8
+#define DIAG_ROW_HEIGHT			8
+#define DIAG_VALUE_X			(1 + (METRICS_NAME_MAX + 1) * 6)
+
 #define __min(a,b)	( (a <  b) ? a : b )
 #define __max(a,b)	( (a >= b) ? a : b )
 
 uint8_t delayTimeMs = 50;
 
-static void intToString(int value, uint8_t* pBuf, uint32_t len, uint32_t base)
+static struct pressure_t pressureSensor;
+
+RAMFUNC void SysTick_Handler(void) {
+#ifdef RAMFUNC_BENCH
+    // First, before the count moves on
+    uint32_t val = SysTick->VAL;
+    rambench_tick(SysTick->LOAD - val);
+#endif
+    msTicks++;
+    clock_tick();
+    input_tick();
+}
+
+static uint32_t getTicks(void)
 {
-    static const char* pAscii = "0123456789abcdefghijklmnopqrstuvwxyz";
-    int pos = 0;
-    int tmpValue = value;
+    return msTicks;
+}
 
-    // the buffer must not be null and at least have a length of 2 to handle one
-    // digit and null-terminator
-    if (pBuf == NULL || len < 2)
-    {
-        return;
-    }
+// Deepest stack use reported so far
+static uint32_t stackPeak = 0;
 
-    // a valid base cannot be less than 2 or larger than 36
-    // a base value of 2 means binary representation. A value of 1 would mean only zeros
-    // a base larger than 36 can only be used if a larger alphabet were used.
-    if (base < 2 || base > 36)
-    {
-        return;
-    }
+// Sends a memory frame if the stack went deeper than last reported. The
+// scan walks the free RAM, so it runs with the telemetry, not every pass.
+static void report_memory(void)
+{
+	uint32_t peak = stackmon_peak();
 
-    // negative value
-    if (value < 0)
-    {
-        tmpValue = -tmpValue;
-        value    = -value;
-        pBuf[pos++] = '-';
-    }
+	if (peak <= stackPeak)
+		return;
+	stackPeak = peak;
+	metrics_set(METRIC_STACK_PEAK, peak);
+	telemetry_memory((uint16_t)stackmon_static(), (uint16_t)stackmon_size(), (uint16_t)peak);
+}
 
-    // calculate the required length of the buffer
-    do {
-        pos++;
-        tmpValue /= base;
-    } while(tmpValue > 0);
+// Samples sent since the last clock, latency and metrics frames
+static uint8_t sinceStatsReport = 0;
 
+// Sends the clock frame, the latency histograms, which then start over,
+// the metrics and the energy estimate
+static void report_stats(void)
+{
+	struct energy_report energy;
+	uint8_t path;
+
+	if (++sinceStatsReport < TELEMETRY_STATS_EVERY)
+		return;
+	sinceStatsReport = 0;
+	telemetry_clock(clock_ms(CLOCK_FAST), clock_ms(CLOCK_IDLE), clock_switches());
+	for (path = 0; path < LATENCY_PATHS; path++)
+	{
+		telemetry_latency(path, latency_get(path));
+		latency_clear(path);
+	}
+	telemetry_metrics();
+	energy_take(&energy, TELEMETRY_STATS_EVERY);
+	telemetry_energy(&energy);
+}
 
-    if (pos > len)
-    {
-        // the len parameter is invalid.
-        return;
-    }
+// Tick count up to which METRIC_UPTIME_S has counted
+static uint32_t uptimeMs = MS_TICKS_START;
 
-    pBuf[pos] = '\0';
+// Ends the work of a pass, started at passMs, before its delay
+static void pass_done(uint32_t passMs)
+{
+	uint32_t now = getTicks();
+	uint32_t seconds = (now - uptimeMs) / 1000;
 
-    do {
-        pBuf[--pos] = pAscii[value % base];
-        value /= base;
-    } while(value > 0);
+	metrics_add(METRIC_UPTIME_S, seconds);
+	uptimeMs += seconds * 1000;
+	if (now - passMs > delayTimeMs)
+		metrics_add(METRIC_LOOP_OVERRUNS, 1);
+}
 
-    return;
+// The delay between passes, cut short by user input. The PLL the last
+// fast section left held is dropped halfway if its hold runs out first.
+static void idle_wait(uint32_t ms)
+{
+	uint32_t hold = clock_hold_ms();
 
+	if (hold < ms)
+	{
+		input_wait(hold);
+		clock_settle();
+		ms -= hold;
+	}
+	input_wait(ms);
 }
 
-void SysTick_Handler(void) {
-    msTicks++;
+// First metric on the diagnostics page, and the values drawn
+static uint8_t diagFirst = 0;
+static uint32_t diagShown[DIAG_ROWS];
+
+// Draws the metrics whose value changed, or all of them with their names
+static void draw_diagnostics(uint8_t changed)
+{
+	uint8_t text[12];
+	uint8_t row, y;
+	uint32_t value;
+
+	if (changed == 1)
+		oled_clearScreen(OLED_COLOR_BLACK);
+	for (row = 0; row < DIAG_ROWS && diagFirst + row < METRICS; row++)
+	{
+		y = row * DIAG_ROW_HEIGHT;
+		value = metrics_get(diagFirst + row);
+		if (changed == 1)
+			oled_putString(1, y, (uint8_t*)metrics_name(diagFirst + row), OLED_COLOR_WHITE, OLED_COLOR_BLACK);
+		else if (value == diagShown[row])
+			continue;
+		diagShown[row] = value;
+
+		intToString((int)value, text, sizeof(text), 10);
+		if (changed != 1)
+			oled_fillRect(DIAG_VALUE_X, y, 95, y + DIAG_ROW_HEIGHT - 1, OLED_COLOR_BLACK);
+		oled_putString(DIAG_VALUE_X, y, text, OLED_COLOR_WHITE, OLED_COLOR_BLACK);
+	}
 }
 
-static uint32_t getTicks(void)
+// Channel each page shows
+static const uint8_t pageChannel[] = { SAMPLE_TEMP, SAMPLE_LIGHT, SAMPLE_PRESSURE };
+
+// Read start of the reading each channel last showed
+static uint32_t shownMs[SAMPLE_CHANNELS];
+
+// Times a reading from its start to the OLED, the first time it is drawn
+static void note_shown(uint8_t channel)
 {
-    return msTicks;
+	uint32_t readMs = samples_read_ms(SAMPLE_MASK(channel));
+
+	if (readMs == shownMs[channel])
+		return;
+	shownMs[channel] = readMs;
+	latency_record(LATENCY_SAMPLE_DISPLAY, getTicks() - readMs);
+}
+
+#ifdef PRESSURE_BURST
+// Converts pressure back to back instead of sleeping, until ms have passed
+// or input arrives. Fast outputs go to the telemetry, slow ones to the
+// sample cache.
+static void pressure_burst_wait(uint32_t ms, int32_t temp, uint32_t lux)
+{
+	uint32_t start = getTicks();
+	uint32_t now = start;
+
+	// At the PLL throughout: the conversions are too short to switch for
+	// (see clock_delay_ms())
+	clock_fast();
+	pressure_note_temperature(&pressureSensor, temp);
+	while (record_u8(REC_CLOCK, (now - start) < ms) && !input_pending())
+	{
+		uint8_t ready = pressure_burst_step(&pressureSensor);
+
+		if (ready & PRESSURE_BURST_FAST)
+		{
+			// The step's conversion started after now was read
+			uint8_t due = telemetry_due(now);
+
+#ifdef TELEMETRY_RAW
+			telemetry_raw(now, temp, lux, pressureSensor.ut, pressureSensor.up);
+#else
+			telemetry_sample(now, temp, lux, pressureSensor.pressure);
+#endif
+			if (due)
+				latency_record(LATENCY_SAMPLE_UART, getTicks() - now);
+			report_memory();
+			report_stats();
+		}
+		if (ready & PRESSURE_BURST_SLOW)
+			samples_put(SAMPLE_PRESSURE, pressureSensor.slowPressure);
+		now = getTicks();
+	}
+	clock_release();
 }
+#endif
 
 void InitSysTick()
 {
@@ -124,19 +267,16 @@ void InitSysTick()
 //------------------------------------------------------------------------
 void RetrieveCachedData(uint8_t *pOutTemp, uint8_t *pOutLux, uint8_t *pOutPressure )
 {
-	char buf[32];
-    memset(buf, 0, 32);
+	char buf[SNAPSHOT_SIZE];
+	int32_t temp;
+	uint32_t lux;
+	int32_t pressure;
+    memset(buf, 0, SNAPSHOT_SIZE);
 
-	int16_t len = eeprom_read(buf, 240, 32);
+	int16_t len = eeprom_read(buf, 240, SNAPSHOT_SIZE);
 
-	if ( buf[0] == '7' && buf[1] == '6' && buf[2] == '5' )
+	if (snapshot_decode(buf, &temp, &lux, &pressure))
 	{
-		 int32_t temp = 0;
-		 uint32_t lux = 0;
-		 int32_t pressure = 0;
-
-		sscanf(buf, "765;%d;%d;%d;", &temp, &lux, &pressure);
-
 		intToString(temp, pOutTemp, 8, 10);
 		intToString(lux,  pOutLux,  8, 10);
 		intToString(pressure, pOutPressure, 8, 10);
@@ -151,8 +291,8 @@ void RetrieveCachedData(uint8_t *pOutTemp, uint8_t *pOutLux, uint8_t *pOutPressu
 //------------------------------------------------------------------------
 void SaveCachedData(uint8_t *pressure)
 {
-	int32_t temp = temp_read();
-	uint32_t lux = light_read();
+	int32_t temp = samples_get(SAMPLE_TEMP, DISPLAY_MAX_AGE_MS);
+	uint32_t lux = (uint32_t)samples_get(SAMPLE_LIGHT, DISPLAY_MAX_AGE_MS);
 
 	/*
 	uint8_t bufTemp[8];
@@ -161,12 +301,11 @@ void SaveCachedData(uint8_t *pressure)
 	intToString(lux, bufLight, 8, 10);
 	*/
 
-	char buffer[32];
-	memset(buffer, 0, 32);
-
-	sprintf(buffer, "765;%d;%d;%s;", temp, lux, pressure); //765 as control number
+	char buffer[SNAPSHOT_SIZE];
+	snapshot_encode(buffer, temp, lux, pressure);
 
-	int16_t len = eeprom_write(buffer, 240, 32);
+	int16_t len = eeprom_write(buffer, 240, SNAPSHOT_SIZE);
+	metrics_add(METRIC_EEPROM_WRITES, 1);
 	return;
 }
 
@@ -176,7 +315,11 @@ int main (void)
 	// Values from sensors
     int32_t temp = 0;
     uint32_t lux = 0;
-    uint8_t joy = 0;
+    uint32_t sampleMs;
+    uint8_t fresh, sendSample;
+    // Value on the sensor page; its redraw is skipped while it holds
+    int32_t shownValue = 0;
+    uint8_t shownValid = 0;
 
     uint8_t prevTemp[8];
     uint8_t prevLux[8];
@@ -184,15 +327,15 @@ int main (void)
 
 
     int8_t current_page = 0;
-    uint8_t buf2[1];
-    uint8_t rotaryReadVal = ROTARY_WAIT;
+    uint8_t buf2[2];
     uint8_t max_page;
-    uint8_t pressure[8];
+    int8_t diag_page;
+    uint8_t pressure[8] = "";
     GPIOInit();
     GPIOSetDir(PORT0, 1, 0);
     init_timer32(0, 10);
 
-    UARTInit(115200);
+    UARTInit(UART_BAUD);
     UARTSendString((uint8_t*)"WeatherStation5000\r\n");
 
 
@@ -202,11 +345,18 @@ int main (void)
     oled_init();
     light_init();
     temp_init(&getTicks);
+    temperature_init();
     joystick_init();
     rgb_init();
     rotary_init();
     light_enable();
     InitSysTick();
+#ifdef RAMFUNC_BENCH
+    rambench_run();
+#endif
+    input_init(&getTicks);
+    record_init(&getTicks);
+    telemetry_init();
 
 
     RetrieveCachedData(prevTemp, prevLux, prevPressure);
@@ -216,14 +366,28 @@ int main (void)
 	oled_putString(1,TOP_LEFT,  (uint8_t*)"Loading...",OLED_COLOR_WHITE , OLED_COLOR_BLACK);
 
 
-	uint8_t isPressure = init_pressure();
+	pressure_default_bus(&pressureSensor);
+	pressure_set_clock(&pressureSensor, &getTicks);
+	uint8_t isPressure = init_pressure(&pressureSensor);
+	samples_init(&getTicks, (isPressure == 1) ? &pressureSensor : NULL);
     if(isPressure == 1)
     {
         oled_clearScreen(OLED_COLOR_BLACK);
     	oled_putString(1,TOP_LEFT,  (uint8_t*)"Calc. pressure...",OLED_COLOR_WHITE , OLED_COLOR_BLACK);
-        intToString((int)get_pressure(), pressure, 8, 10);
+        samples_refresh(SAMPLE_ALL, 0);
+        intToString((int)record_s32(REC_PRESSURE, samples_get(SAMPLE_PRESSURE, DISPLAY_MAX_AGE_MS)), pressure, 8, 10);
         max_page = 2;
         rgb_setLeds(RGB_GREEN);
+#ifdef PRESSURE_BURST
+        pressure_burst_start(&pressureSensor, PRESSURE_BURST_SLOW_LOG2);
+#endif
+#ifdef TELEMETRY_RAW
+        {
+            uint8_t prom[PRESSURE_PROM_SIZE];
+            pressure_prom(&pressureSensor, prom);
+            telemetry_calibration(prom, PRESSURE_OSS);
+        }
+#endif
     }
     else
     {
@@ -231,63 +395,103 @@ int main (void)
     	rgb_setLeds(RGB_RED | RGB_GREEN);
     }
 
+    // Diagnostics after the sensor pages
+    diag_page = max_page + 1;
+    max_page = diag_page;
+
     SaveCachedData(pressure);
 
     oled_clearScreen(OLED_COLOR_BLACK);
+    report_memory();
+
+    // From here on the core idles at the IRC between fast sections
+    clock_init(UART_BAUD);
+    energy_init(UART_BAUD);
 
     while(1)
     {
-    	//joystick read
-    	joy = joystick_read();
+    	// Input events queued by the GPIO interrupts since the last pass
     	uint8_t changed = 0;
-		if ((joy & JOYSTICK_LEFT) != 0)
-		{
-			current_page--;
-			if(current_page == -1)
-				current_page = max_page;
-			changed = 1;
-		}
-		else if ((joy & JOYSTICK_RIGHT) != 0 || GPIOGetValue(PORT0, 1) == 0) //0 means true
-		{
-			current_page++;
-			if(current_page == max_page+1)
-				current_page = 0;
-			changed = 1;
-		}
-
-
-		// Sprawdz stan rotacyjnego przelacznika kwadraturowego
-		rotaryReadVal = rotary_read();
-		switch (rotaryReadVal)
-		{
-		case ROTARY_RIGHT:
-		{
-			delayTimeMs -= 50;
-			if(delayTimeMs < 1)
-				delayTimeMs = 1;
-			//delayTimeMs = __max(1, delayTimeMs);
-			break;
-		}
-
-		case ROTARY_LEFT:
-		{
-			delayTimeMs += 50;
-			if(delayTimeMs > 500)
-				delayTimeMs = 500;
-			//delayTimeMs = __min(200, delayTimeMs);
-			break;
-		}
-
-		default:
-			break;
-		}
-
-
-		switch(current_page)
+    	uint8_t inputs = 0;
+    	uint32_t inputMs = 0;
+    	uint32_t passMs = getTicks();
+    	uint32_t oledUs;
+    	int32_t value;
+    	uint8_t event;
+    	while ((event = record_u8(REC_INPUT, input_get())) != INPUT_NONE)
+    	{
+    		// The first event of a pass is the one that waited longest
+    		if (!inputs)
+    			inputMs = input_event_ms();
+    		inputs = 1;
+    		switch (event)
+    		{
+    		case INPUT_LEFT:
+    			current_page--;
+    			if(current_page == -1)
+    				current_page = max_page;
+    			changed = 1;
+    			break;
+
+    		case INPUT_RIGHT:
+    		case INPUT_BUTTON:
+    			current_page++;
+    			if(current_page == max_page+1)
+    				current_page = 0;
+    			changed = 1;
+    			break;
+
+    		case INPUT_UP:
+    			if (current_page == diag_page && diagFirst > 0)
+    			{
+    				diagFirst--;
+    				changed = 1;
+    			}
+    			break;
+
+    		case INPUT_DOWN:
+    			if (current_page == diag_page && diagFirst + DIAG_ROWS < METRICS)
+    			{
+    				diagFirst++;
+    				changed = 1;
+    			}
+    			break;
+
+    		case INPUT_ROTARY_RIGHT:
+    			delayTimeMs -= 50;
+    			if(delayTimeMs < 1)
+    				delayTimeMs = 1;
+    			break;
+
+    		case INPUT_ROTARY_LEFT:
+    			delayTimeMs += 50;
+    			if(delayTimeMs > 500)
+    				delayTimeMs = 500;
+    			break;
+
+    		default:
+    			break;
+    		}
+    	}
+
+		// The page update (sensor reads, compensation, OLED) at full speed;
+		// the OLED is timed from after the read
+		if (changed == 1)
+			shownValid = 0;
+		clock_fast();
+		oledUs = clock_us();
+		if (current_page == diag_page)
+			draw_diagnostics(changed);
+		else switch(current_page)
 			{
 				case 0:
 				{
-					temp = temp_read();
+					temp = samples_get(SAMPLE_TEMP, DISPLAY_MAX_AGE_MS);
+					oledUs = clock_us();
+					if (shownValid && temp == shownValue)
+						break;
+					shownValue = temp;
+					shownValid = 1;
 					intToString(temp, buf, 10, 10);
 					buf2[0] = buf[2];
 					buf2[1] = '\0';
@@ -311,7 +515,12 @@ int main (void)
 
 				case 1:
 				{
-					lux = light_read();
+					lux = (uint32_t)samples_get(SAMPLE_LIGHT, DISPLAY_MAX_AGE_MS);
+					oledUs = clock_us();
+					if (shownValid && (int32_t)lux == shownValue)
+						break;
+					shownValue = (int32_t)lux;
+					shownValid = 1;
 					intToString(lux, buf, 10, 10);
 
 					if(changed == 1) //refresh label
@@ -329,23 +538,84 @@ int main (void)
 				}
 				case 2:
 				{
+					value = record_s32(REC_PRESSURE, samples_get(SAMPLE_PRESSURE, DISPLAY_MAX_AGE_MS));
+					oledUs = clock_us();
+					if (shownValid && value == shownValue)
+						break;
+					shownValue = value;
+					shownValid = 1;
+					intToString((int)value, pressure, 8, 10);
 					if(changed == 1)
 					{
 						oled_clearScreen(OLED_COLOR_BLACK);
 						oled_putString(1,TOP_LEFT,  (uint8_t*)"Press:", OLED_COLOR_WHITE,OLED_COLOR_BLACK );
-						oled_fillRect((1+9*5),TOP_LEFT,90, TOP_LEFT+8, OLED_COLOR_BLACK);
-						oled_putString((1+9*5),TOP_LEFT, pressure,OLED_COLOR_WHITE ,OLED_COLOR_BLACK );
-
-						oled_fillRect((1+9*5),TOP_LEFT+8,90, TOP_LEFT+16, OLED_COLOR_BLACK);
-						oled_putString((1+9*5),TOP_LEFT +8, prevPressure,OLED_COLOR_WHITE ,OLED_COLOR_BLACK );
 					}
+
+					oled_fillRect((1+9*5),TOP_LEFT,90, TOP_LEFT+8, OLED_COLOR_BLACK);
+					oled_putString((1+9*5),TOP_LEFT, pressure,OLED_COLOR_WHITE ,OLED_COLOR_BLACK );
+
+					oled_fillRect((1+9*5),TOP_LEFT+8,90, TOP_LEFT+16, OLED_COLOR_BLACK);
+					oled_putString((1+9*5),TOP_LEFT +8, prevPressure,OLED_COLOR_WHITE ,OLED_COLOR_BLACK );
 					break;
 				}
 			}
+		energy_add_us(ENERGY_OLED, clock_us() - oledUs);
+		clock_release();
+		if (inputs)
+			latency_record(LATENCY_INPUT_PAGE, getTicks() - inputMs);
+		if (current_page != diag_page)
+			note_shown(pageChannel[current_page]);
+
+		record_tick(current_page, delayTimeMs, temp, lux);
+#ifdef PRESSURE_BURST
+		// Burst mode sends its own telemetry while it waits
+		if (isPressure == 1)
+		{
+			pass_done(passMs);
+			pressure_burst_wait(delayTimeMs, temp, lux);
+			continue;
+		}
+#endif
+		// Every clock read is followed by a record in the same ms, see record.h
+		sampleMs = getTicks();
+		fresh = 0;
+		sendSample = 0;
+		if (record_u8(REC_CLOCK, telemetry_due(sampleMs)))
+		{
+			// The channels' own periods pace the reads the telemetry asks
+			// for. New readings (the OLED's too) go out, or a frame every
+			// TELEMETRY_MAX_PERIOD_MS while nothing changes
+			samples_refresh(SAMPLE_ALL, SAMPLE_PERIOD);
+			fresh = samples_updated();
+			sendSample = fresh != 0 || record_u8(REC_CLOCK, telemetry_overdue(sampleMs));
+		}
+		if (sendSample)
+		{
+			temp = samples_get(SAMPLE_TEMP, SAMPLE_PERIOD);
+			lux = (uint32_t)samples_get(SAMPLE_LIGHT, SAMPLE_PERIOD);
+#ifdef TELEMETRY_RAW
+			// Compensation is left to the collector; without a BMP180, ut and
+			// up go out as 0 and, never given a calibration, the collector
+			// marks the pressure invalid
+			if (isPressure == 1)
+				telemetry_raw(sampleMs, temp, lux, pressureSensor.ut, pressureSensor.up);
+			else
+				telemetry_raw(sampleMs, temp, lux, 0, 0);
+			if (fresh != 0)
+				latency_record(LATENCY_SAMPLE_UART, getTicks() - samples_read_ms(fresh));
+#else
+			telemetry_sample(sampleMs, temp, lux, samples_get(SAMPLE_PRESSURE, SAMPLE_PERIOD));
+			if (fresh != 0)
+				latency_record(LATENCY_SAMPLE_UART, getTicks() - samples_read_ms(fresh));
+#endif
+			report_memory();
+			report_stats();
+		}
 
+		pass_done(passMs);
 
-        /* delay */
-        delay32Ms(0, delayTimeMs);
+        /* delay, cut short by user input */
+        idle_wait(delayTimeMs);
     }
 
 }
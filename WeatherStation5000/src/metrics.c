@@ -0,0 +1,14 @@
+#include "type.h"
+#include "../include/metrics.h"
+
+uint32_t metricsValues[METRICS];
+
+static const char *const names[METRICS] = {
+	"uptime", "overrun", "i2c err", "i2c rty", "temp rd", "lux rd", "prs rd",
+	"eeprom", "tlm drp", "in drop", "stack"
+};
+
+const char *metrics_name(uint8_t id)
+{
+	return (id < METRICS) ? names[id] : "";
+}
@@ -2,207 +2,275 @@
 #include "type.h"
 #include "uart.h"
 #include "stdio.h"
-#include "timer32.h"
+#include "../include/clockmgr.h"
+#include "../include/energy.h"
 #include "../include/pressure.h"
+#include "../include/pressure180.h"
+#include "../include/record.h"
 
-#define BMP180_ADDRESS 0x77  // I2C address of BMP085
+#define BMP180_CHIP_ID_VALUE	0x55
 
-const unsigned char OSS = 0;  // Oversampling Setting
+static uint8_t start_up(struct pressure_t *pPress, unsigned char oss);
+static uint32_t finish_up(struct pressure_t *pPress, unsigned char oss);
+static uint32_t read_up(struct pressure_t *pPress, unsigned char oss);
 
-//prototypes
-char bmp085Read(unsigned char address);
-int bmp085ReadInt(unsigned char address);
-void bmp085Calibration();
-unsigned int bmp085ReadUT();
-unsigned long bmp085ReadUP();
-short bmp085GetTemperature(unsigned int ut);
-long bmp085GetPressure(unsigned long up);
-
-// Calibration values
-short ac1;
-short ac2;
-short ac3;
-unsigned short ac4;
-unsigned short ac5;
-unsigned short ac6;
-short b1;
-short b2;
-short mb;
-short mc;
-short md;
-
-// b5 is calculated in bmp085GetTemperature(...), this variable is also used in bmp085GetPressure(...)
-// so ...Temperature(...) must be called before ...Pressure(...).
-long b5;
-
-short temperature;
-long pressure;
-
-// Use these for altitude conversions
-const float p0 = 101325;     // Pressure at sea level (Pa)
-float altitude;
-
-uint8_t init_pressure()
+void pressure_default_bus(struct pressure_t *pPress)
 {
-	  ac1 = bmp085ReadInt(0xAA);
-	  ac2 = bmp085ReadInt(0xAC);
-	  ac3 = bmp085ReadInt(0xAE);
-	  ac4 = bmp085ReadInt(0xB0);
-	  ac5 = bmp085ReadInt(0xB2);
-	  ac6 = bmp085ReadInt(0xB4);
-	  b1 = bmp085ReadInt(0xB6);
-	  b2 = bmp085ReadInt(0xB8);
-	  mb = bmp085ReadInt(0xBA);
-	  mc = bmp085ReadInt(0xBC);
-	  md = bmp085ReadInt(0xBE);
-
-	  return (ac1 == ac2 && ac2 == ac3) ? 0 : 1;
+	BMP180Bus(&pPress->bmp);
 }
 
-long get_pressure()
+void pressure_set_clock(struct pressure_t *pPress, uint32_t (*getMsTicks)(void))
 {
-	bmp085GetTemperature(bmp085ReadUT());
-	return bmp085GetPressure(bmp085ReadUP());
+	pPress->getMsTicks = getMsTicks;
 }
 
-// Read 1 byte from the BMP085 at 'address'
-char bmp085Read(unsigned char address)
+void pressure_note_temperature(struct pressure_t *pPress, int32_t ambient)
 {
-  unsigned char buf[1];
-  unsigned char addr[1];
-  addr[0] = address;
-  I2CWrite(0xEE,addr,1);
-  I2CRead(0xEF,buf,1);
-  //Wire.beginTransmission(BMP180_ADDRESS);
-  //Wire.write(address);
-  //Wire.endTransmission();
-
-  return buf[0];
+	pPress->ambient = ambient;
+	if (pPress->b5Valid && (ambient - pPress->b5Ambient >= PRESSURE_B5_MAX_DELTA
+		|| pPress->b5Ambient - ambient >= PRESSURE_B5_MAX_DELTA))
+		pPress->b5Valid = 0;
 }
 
-// Read 2 bytes from the BMP085
-// First byte will be from 'address'
-// Second byte will be from 'address'+1
-int bmp085ReadInt(unsigned char address)
+// True when the cached ut/b5 may not be reused for the next pressure
+static uint8_t b5_stale(struct pressure_t *pPress)
 {
-  //Wire.beginTransmission(BMP180_ADDRESS);
-  //Wire.write(address);
-  //Wire.endTransmission();
-
-  //Wire.requestFrom(BMP180_ADDRESS, 2);
-  //while(Wire.available()<2)
-  //  ;
-  //msb = Wire.read();
-  //lsb = Wire.read();
-
-  unsigned char buf[2];
-  unsigned char addr[1];
-  addr[0] = address;
-  I2CWrite(0xEE,addr,1);
-  I2CRead(0xEF,buf,2);
-
-
-  return (int) buf[0]<<8 | buf[1];
+	if (!pPress->b5Valid || pPress->getMsTicks == NULL)
+		return 1;
+	return record_u8(REC_CLOCK,
+		(pPress->getMsTicks() - pPress->b5Ms) >= PRESSURE_B5_MAX_AGE_MS);
 }
 
+uint8_t pressure_temperature_due(struct pressure_t *pPress)
+{
+	return b5_stale(pPress);
+}
 
-// Read the uncompensated temperature value
-unsigned int bmp085ReadUT()
+uint8_t pressure_start_temperature(struct pressure_t *pPress)
 {
-  unsigned int ut;
+	u8 cmd = BMP180_T_MEASURE;
 
-  // Write 0x2E into Register 0xF4
-  // This requests a temperature reading
-  //We have to write [0] - address [1] - value for addr [2] - value for addr+1
-  unsigned char addr[2];
-  addr[0] = 0xF4;
-  addr[1] = 0x2E;
-  I2CWrite(0xEE,addr,2);
+	if (pPress->bmp.bus_write(pPress->bmp.dev_addr, BMP180_CTRL_MEAS_REG, &cmd, 1) != 0)
+		pPress->failed = 1;
+	energy_add_us(ENERGY_BMP180, ENERGY_BMP180_UT_US);
 
-  // Wait at least 4.5ms
-  delay32Ms(0, 5);
+	// At least 4.5ms
+	return BMP180_TEMP_CONVERSION_TIME;
+}
 
-  // Read two bytes from registers 0xF6 and 0xF7
-  ut = bmp085ReadInt(0xF6);
-  return ut;
+void pressure_finish_temperature(struct pressure_t *pPress)
+{
+	u8 buf[BMP180_TEMPERATURE_DATA_BYTES];
+
+	// Before the REC_UT record, see record.h
+	pPress->b5Ms = (pPress->getMsTicks != NULL) ? pPress->getMsTicks() : 0;
+
+	if (pPress->bmp.bus_read(pPress->bmp.dev_addr, BMP180_ADC_OUT_MSB_REG, buf, sizeof(buf)) != 0)
+	{
+		pPress->failed = 1;
+		pPress->b5Valid = 0;
+		return;
+	}
+	pPress->ut = record_u16(REC_UT, (uint16_t)(buf[BMP180_TEMPERATURE_MSB_DATA] << 8
+		| buf[BMP180_TEMPERATURE_LSB_DATA]));
+
+	// Leaves b5 in bmp.param_b5 for the pressures that follow
+	pPress->temperature = bmp180_get_temperature(&pPress->bmp, pPress->ut);
+	pPress->b5Ambient = pPress->ambient;
+	pPress->b5Valid = 1;
+	pPress->tempConversions++;
 }
 
-// Read the uncompensated pressure value
-unsigned long bmp085ReadUP()
+uint8_t pressure_start_pressure(struct pressure_t *pPress)
 {
-  unsigned char msb, lsb, xlsb;
-  unsigned long up = 0;
+	pPress->pressConversions++;
+	return start_up(pPress, PRESSURE_OSS);
+}
 
-  // Write 0x34+(OSS<<6) into register 0xF4
-  // Request a pressure reading w/ oversampling setting
-  unsigned char addr[2];
-  addr[0] = 0xF4;
-  addr[1] = 0x34 + (OSS<<6);
+void pressure_finish_pressure(struct pressure_t *pPress)
+{
+	pPress->up = finish_up(pPress, PRESSURE_OSS);
+}
 
-  // Wait for conversion, delay time dependent on OSS
-  delay32Ms(0,2 + (3<<OSS));
+static void refresh_b5(struct pressure_t *pPress)
+{
+	uint8_t ms = pressure_start_temperature(pPress);
 
-  // Read register 0xF6 (MSB), 0xF7 (LSB), and 0xF8 (XLSB)
-  unsigned char buf[3];
-  addr[0] = 0xF6;
-  I2CWrite(0xEE,addr,1);
-  I2CRead(0xEF,buf,3);
+	if (pPress->failed)
+		return;
+	clock_delay_ms(ms);
+	pressure_finish_temperature(pPress);
+}
 
-  msb = buf[0];
-  lsb = buf[1];
-  xlsb = buf[2];
+int32_t pressure_job_step(void *pCtx)
+{
+	struct pressure_t *pPress = (struct pressure_t *)pCtx;
+	int32_t ms;
+
+	switch (pPress->jobState)
+	{
+	case PRESSURE_JOB_IDLE:
+		pPress->failed = 0;
+		if (b5_stale(pPress))
+		{
+			pPress->jobState = PRESSURE_JOB_UT;
+			ms = pressure_start_temperature(pPress);
+			break;
+		}
+		pPress->jobState = PRESSURE_JOB_UP;
+		ms = pressure_start_pressure(pPress);
+		break;
+
+	case PRESSURE_JOB_UT:
+		pressure_finish_temperature(pPress);
+		pPress->jobState = PRESSURE_JOB_UP;
+		ms = pPress->failed ? 0 : pressure_start_pressure(pPress);
+		break;
+
+	default:
+		pressure_finish_pressure(pPress);
+		if (!pPress->failed)
+			pPress->pressure = bmp180_get_pressure(&pPress->bmp, pPress->up);
+		pPress->jobState = PRESSURE_JOB_IDLE;
+		return I2CSCHED_DONE;
+	}
+
+	// The reading is abandoned at the first bus error
+	if (pPress->failed)
+	{
+		pPress->jobState = PRESSURE_JOB_IDLE;
+		return I2CSCHED_DONE;
+	}
+	return ms;
+}
 
-  up = (((unsigned long) msb << 16) | ((unsigned long) lsb << 8) | (unsigned long) xlsb) >> (8-OSS);
+uint8_t init_pressure(struct pressure_t *pPress)
+{
+	pPress->b5Valid = 0;
+	bmp180_init(&pPress->bmp);
+	pPress->bmp.oversamp_setting = PRESSURE_OSS;
+
+#ifdef RECORD_ENABLE
+	{
+		unsigned char prom[PRESSURE_PROM_SIZE];
+		pressure_prom(pPress, prom);
+		record_emit(REC_CALIB, prom, sizeof(prom));
+	}
+#endif
+
+	return (pPress->bmp.chip_id == BMP180_CHIP_ID_VALUE) ? 1 : 0;
+}
 
-  return up;
+// Re-packs the calibration in chip order (big-endian, 0xAA..0xBF)
+void pressure_prom(const struct pressure_t *pPress, uint8_t *pProm)
+{
+	const struct bmp180_calib_param_t *pCal = &pPress->bmp.calib_param;
+	uint16_t calib[11] = { pCal->ac1, pCal->ac2, pCal->ac3,
+			pCal->ac4, pCal->ac5, pCal->ac6, pCal->b1, pCal->b2,
+			pCal->mb, pCal->mc, pCal->md };
+	int i;
+
+	for (i = 0; i < 11; i++)
+	{
+		pProm[2*i]   = (uint8_t)(calib[i] >> 8);
+		pProm[2*i+1] = (uint8_t)calib[i];
+	}
 }
 
+void pressure_read_raw(struct pressure_t *pPress)
+{
+	pPress->failed = 0;
+	if (b5_stale(pPress))
+		refresh_b5(pPress);
+	if (pPress->failed)
+		return;
+	pPress->up = read_up(pPress, PRESSURE_OSS);
+	pPress->pressConversions++;
+}
 
-// Calculate temperature given ut.
-// Value returned will be in units of 0.1 deg C
-short bmp085GetTemperature(unsigned int ut)
+int32_t get_pressure(struct pressure_t *pPress)
 {
-  long x1, x2;
+	pressure_read_raw(pPress);
+	if (!pPress->failed)
+		pPress->pressure = bmp180_get_pressure(&pPress->bmp, pPress->up);
+	return pPress->pressure;
+}
 
-  x1 = (((long)ut - (long)ac6)*(long)ac5) >> 15;
-  x2 = ((long)mc << 11)/(x1 + md);
-  b5 = x1 + x2;
+void pressure_burst_start(struct pressure_t *pPress, uint8_t slowLog2)
+{
+	decimate_init(&pPress->fast, PRESSURE_OSS, 0);
+	decimate_init(&pPress->slow, slowLog2, slowLog2);
+}
 
-  return ((b5 + 8)>>4);
+uint8_t pressure_burst_step(struct pressure_t *pPress)
+{
+	uint32_t up, out;
+	uint8_t ready = 0;
+
+	// Only between fast outputs, so all conversions summed into one
+	// share the same b5
+	pPress->failed = 0;
+	if (pPress->fast.count == 0 && b5_stale(pPress))
+		refresh_b5(pPress);
+	if (pPress->failed)
+		return 0;
+
+	pPress->pressConversions++;
+	up = read_up(pPress, 0);
+	if (pPress->failed)
+		return 0;
+	if (decimate_push(&pPress->fast, up, &out))
+	{
+		pPress->up = out;
+		pPress->pressure = bmp180_get_pressure(&pPress->bmp, out);
+		ready |= PRESSURE_BURST_FAST;
+
+		if (decimate_push(&pPress->slow, out, &out))
+		{
+			pPress->slowUp = out;
+			pPress->slowPressure = bmp180_get_pressure(&pPress->bmp, out);
+			ready |= PRESSURE_BURST_SLOW;
+		}
+	}
+	return ready;
 }
 
-// Calculate pressure given up
-// calibration values must be known
-// b5 is also required so bmp085GetTemperature(...) must be called first.
-// Value returned will be pressure in units of Pa.
-long bmp085GetPressure(unsigned long up)
+static uint32_t read_up(struct pressure_t *pPress, unsigned char oss)
 {
-  long x1, x2, x3, b3, b6, p;
-  unsigned long b4, b7;
+	uint8_t ms = start_up(pPress, oss);
 
-  b6 = b5 - 4000;
-  // Calculate B3
-  x1 = (b2 * (b6 * b6)>>12)>>11;
-  x2 = (ac2 * b6)>>11;
-  x3 = x1 + x2;
-  b3 = (((((long)ac1)*4 + x3)<<OSS) + 2)>>2;
+	if (pPress->failed)
+		return pPress->up;
+	clock_delay_ms(ms);
+	return finish_up(pPress, oss);
+}
 
-  // Calculate B4
-  x1 = (ac3 * b6)>>13;
-  x2 = (b1 * ((b6 * b6)>>12))>>16;
-  x3 = ((x1 + x2) + 2)>>2;
-  b4 = (ac4 * (unsigned long)(x3 + 32768))>>15;
+// Returns the conversion time in ms
+static uint8_t start_up(struct pressure_t *pPress, unsigned char oss)
+{
+	u8 cmd = BMP180_P_MEASURE + (oss << 6);
 
-  b7 = ((unsigned long)(up - b3) * (50000>>OSS));
-  if (b7 < 0x80000000)
-    p = (b7<<1)/b4;
-  else
-    p = (b7/b4)<<1;
+	if (pPress->bmp.bus_write(pPress->bmp.dev_addr, BMP180_CTRL_MEAS_REG, &cmd, 1) != 0)
+		pPress->failed = 1;
+	energy_add_us(ENERGY_BMP180, ENERGY_BMP180_UP_US(oss));
 
-  x1 = (p>>8) * (p>>8);
-  x1 = (x1 * 3038)>>16;
-  x2 = (-7357 * p)>>16;
-  p += (x1 + x2 + 3791)>>4;
+	// Conversion time dependent on OSS
+	return BMP180_2MS_DELAY_U8X + (BMP180_3MS_DELAY_U8X << oss);
+}
 
-  return p;
+static uint32_t finish_up(struct pressure_t *pPress, unsigned char oss)
+{
+	u8 buf[BMP180_PRESSURE_DATA_BYTES];
+	uint32_t up;
+
+	if (pPress->bmp.bus_read(pPress->bmp.dev_addr, BMP180_ADC_OUT_MSB_REG, buf, sizeof(buf)) != 0)
+	{
+		pPress->failed = 1;
+		return pPress->up;
+	}
+	up = (((uint32_t)buf[BMP180_PRESSURE_MSB_DATA] << 16)
+		| ((uint32_t)buf[BMP180_PRESSURE_LSB_DATA] << 8)
+		| (uint32_t)buf[BMP180_PRESSURE_XLSB_DATA]) >> (8 - oss);
+
+	return record_u32(REC_UP, up);
 }
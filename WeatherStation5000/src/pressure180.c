@@ -4,44 +4,40 @@
 #include "stdio.h"
 #include "timer32.h" // delay32Ms
 #include "i2c.h"
+#include "../include/i2csched.h"
 #include "../include/pressure180.h"
 
+// Register address plus the longest write the driver issues
+#define BMP180_WRITE_MAX	8
+
 s8 BMP180_I2C_bus_write(u8 dev_addr, u8 reg_addr, u8 *reg_data, u8 cnt)
 {
 	u8 stringpos=0;
-	u8 array[8] = { 0 };
-	array[0] = reg_addr;
+	u8 array[BMP180_WRITE_MAX] = { 0 };
+
+	if (cnt >= BMP180_WRITE_MAX)
+		return E_BMP_COMM_RES;
 
+	array[0] = reg_addr;
 	while (stringpos < cnt)
 	{
-		array[stringpos - 1] = *(reg_data + stringpos);
+		array[stringpos + 1] = *(reg_data + stringpos);
 		stringpos++;
 	}
 
-	I2CWrite(0xEE, array, cnt-1);
-
+	if (i2csched_write(dev_addr << 1, array, cnt + 1) != SUCCESS)
+		return E_BMP_COMM_RES;
 
 	return BMP180_INIT_VALUE;
 }
 
 //------------------------------------------------------------------------
+// One register address write, then cnt bytes read with auto-increment
 s8 BMP180_I2C_bus_read(u8 dev_addr, u8 reg_addr, u8 *reg_data, u8 cnt)
 {
-	u8 stringpos=0;
-	uint8_t byte = 0;
-
-	unsigned char buf[1] = { reg_addr };
-
-	while (stringpos < cnt)
-	{
-		u8 *addr = reg_addr + stringpos;
-
-		I2CWrite(0xEE, addr, 1);
-		I2CRead(0xEF, &byte, 1);
-
-		*(reg_data + stringpos) = byte;
-		stringpos++;
-	}
+	if (i2csched_write(dev_addr << 1, &reg_addr, 1) != SUCCESS
+		|| i2csched_read((dev_addr << 1) | 1, reg_data, cnt) != SUCCESS)
+		return E_BMP_COMM_RES;
 
 	return BMP180_INIT_VALUE;
 }
@@ -53,12 +49,16 @@ void BMP180_delay_msek(u32 msek)
 }
 
 //------------------------------------------------------------------------
+void BMP180Bus(struct bmp180_t *bmp180)
+{
+	bmp180->bus_write = BMP180_I2C_bus_write;
+	bmp180->bus_read =  BMP180_I2C_bus_read;
+	bmp180->dev_addr =  BMP180_I2C_ADDR;
+	bmp180->delay_msec= BMP180_delay_msek;
+}
 
-
-// Struktura do operacji na BMP180
-struct bmp180_t bmp180;
-
-s32 BMP180Init()
+// Struktura do operacji na BMP180 dostarcza wywolujacy
+s32 BMP180Init(struct bmp180_t *bmp180)
 {
 	s32 com_rslt = E_BMP_COMM_RES;
 	u16 v_uncomp_temp_u16 =  BMP180_INIT_VALUE;
@@ -66,27 +66,24 @@ s32 BMP180Init()
 
 
 	// Przypisz odpowiednie funkcje
-	bmp180.bus_write = BMP180_I2C_bus_write;
-	bmp180.bus_read =  BMP180_I2C_bus_read;
-	bmp180.dev_addr =  BMP180_I2C_ADDR;
-	bmp180.delay_msec= BMP180_delay_msek;
+	BMP180Bus(bmp180);
 
 
-	com_rslt =  bmp180_init(&bmp180);
+	com_rslt =  bmp180_init(bmp180);
 
-	com_rslt += bmp180_get_calib_param();
+	com_rslt += bmp180_get_calib_param(bmp180);
 
 
 	// Czytaj nieprzetworzone dane.
-	v_uncomp_temp_u16 =  bmp180_get_uncomp_temperature();
-	v_uncomp_press_u32 = bmp180_get_uncomp_pressure();
+	v_uncomp_temp_u16 =  bmp180_get_uncomp_temperature(bmp180);
+	v_uncomp_press_u32 = bmp180_get_uncomp_pressure(bmp180);
 
 	//if (v_uncomp_press_u32 == 0xF6F6 || v_uncomp_temp_u16 == 0xF6F6)
 	//	return -1;
 
 	// Czytaj prawdziwe dane
-	com_rslt += bmp180_get_temperature(v_uncomp_temp_u16);
-	com_rslt += bmp180_get_pressure(v_uncomp_press_u32);
+	com_rslt += bmp180_get_temperature(bmp180, v_uncomp_temp_u16);
+	com_rslt += bmp180_get_pressure(bmp180, v_uncomp_press_u32);
 
 
 	return com_rslt;
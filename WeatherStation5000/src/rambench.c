@@ -0,0 +1,105 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "uart.h"
+#include "../include/bmp180.h"
+#include "../include/format.h"
+#include "../include/rambench.h"
+
+#ifdef RAMFUNC_BENCH
+
+// Cortex-M3 DWT cycle counter, enabled through the debug unit
+#define DEMCR				(*(volatile uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA		(1UL << 24)
+#define DWT_CTRL			(*(volatile uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA	(1UL << 0)
+#define DWT_CYCCNT			(*(volatile uint32_t *)0xE0001004)
+
+// From ramfunc.ld
+extern unsigned long _ramfunc;
+extern unsigned long _eramfunc;
+
+struct cycles {
+	uint32_t min;
+	uint32_t max;
+	uint32_t sum;
+	uint32_t count;
+};
+
+static struct cycles tickCycles = { 0xFFFFFFFF, 0, 0, 0 };
+static volatile uint32_t ticks = 0;
+
+static void cycles_add(struct cycles *pC, uint32_t cycles)
+{
+	if (cycles < pC->min)
+		pC->min = cycles;
+	if (cycles > pC->max)
+		pC->max = cycles;
+	pC->sum += cycles;
+	pC->count++;
+}
+
+static void print_value(const char *pLabel, uint32_t value)
+{
+	uint8_t text[12];
+
+	UARTSendString((uint8_t *)pLabel);
+	intToString((int)value, text, sizeof(text), 10);
+	UARTSendString(text);
+}
+
+static void print_cycles(const char *pWhat, const struct cycles *pC)
+{
+	UARTSendString((uint8_t *)pWhat);
+	print_value(" cycles min ", pC->min);
+	print_value(" mean ", pC->sum / pC->count);
+	print_value(" max ", pC->max);
+	UARTSendString((uint8_t *)"\r\n");
+}
+
+void rambench_tick(uint32_t cycles)
+{
+	if (ticks < RAMBENCH_RUNS)
+	{
+		cycles_add(&tickCycles, cycles);
+		ticks++;
+	}
+}
+
+void rambench_run(void)
+{
+	// Bosch datasheet example
+	static const struct bmp180_calib_param_t datasheet = {
+		408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868
+	};
+	struct cycles comp = { 0xFFFFFFFF, 0, 0, 0 };
+	struct bmp180_t dev;
+	volatile int32_t sink = 0;
+	uint32_t i, start;
+
+	// SysTick entries, interrupting this loop
+	while (ticks < RAMBENCH_RUNS)
+		;
+
+	DEMCR |= DEMCR_TRCENA;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+	dev.calib_param = datasheet;
+	dev.oversamp_setting = BMP180_INITIALIZE_OSS;
+	for (i = 0; i < RAMBENCH_RUNS; i++)
+	{
+		__disable_irq();
+		start = DWT_CYCCNT;
+		sink += bmp180_get_temperature(&dev, 27000 + (i * 7) % 2000);
+		sink += bmp180_get_pressure(&dev, (23000 + (i * 13) % 2000) << BMP180_INITIALIZE_OSS);
+		cycles_add(&comp, DWT_CYCCNT - start);
+		__enable_irq();
+	}
+
+	print_cycles("ramfunc: SysTick entry", &tickCycles);
+	print_cycles("ramfunc: compensation", &comp);
+	print_value("ramfunc: bytes in RAM ", (uint32_t)&_eramfunc - (uint32_t)&_ramfunc);
+	UARTSendString((uint8_t *)"\r\n");
+}
+
+#endif
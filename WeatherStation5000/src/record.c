@@ -0,0 +1,73 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "uart.h"
+#include "../include/frame.h"
+#include "../include/record.h"
+
+#ifdef RECORD_ENABLE
+
+static uint32_t (*pGetTicks)(void) = NULL;
+
+void record_init(uint32_t (*getMsTicks)(void))
+{
+	pGetTicks = getMsTicks;
+}
+
+void record_emit(uint8_t type, const uint8_t *pData, uint8_t len)
+{
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+	uint8_t frame[FRAME_MAX_SIZE];
+	uint8_t i;
+
+	if (len > FRAME_MAX_PAYLOAD - REC_TS_SIZE)
+		return;
+
+	frame_put_u32(payload, (pGetTicks != NULL) ? pGetTicks() : 0);
+	for (i = 0; i < len; i++)
+		payload[REC_TS_SIZE + i] = pData[i];
+
+	UARTSend(frame, frame_encode(frame, type, payload, len + REC_TS_SIZE));
+}
+
+uint8_t record_u8(uint8_t type, uint8_t value)
+{
+	record_emit(type, &value, 1);
+	return value;
+}
+
+uint16_t record_u16(uint8_t type, uint16_t value)
+{
+	uint8_t data[2];
+
+	frame_put_u16(data, value);
+	record_emit(type, data, sizeof(data));
+	return value;
+}
+
+uint32_t record_u32(uint8_t type, uint32_t value)
+{
+	uint8_t data[4];
+
+	frame_put_u32(data, value);
+	record_emit(type, data, sizeof(data));
+	return value;
+}
+
+int32_t record_s32(uint8_t type, int32_t value)
+{
+	record_u32(type, (uint32_t)value);
+	return value;
+}
+
+void record_tick(uint8_t page, uint8_t delayMs, int32_t temp, uint32_t lux)
+{
+	uint8_t data[10];
+
+	data[0] = page;
+	data[1] = delayMs;
+	frame_put_u32(&data[2], (uint32_t)temp);
+	frame_put_u32(&data[6], lux);
+	record_emit(REC_TICK, data, sizeof(data));
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "light.h"
+#include "../include/i2csched.h"
+#include "../include/metrics.h"
+#include "../include/pressure.h"
+#include "../include/record.h"
+#include "../include/samples.h"
+#include "../include/temperature.h"
+
+// light_read() does two register reads, each an address + command write
+// and an address + data read
+#define LIGHT_READ_BYTES	8
+
+static uint32_t (*pGetTicks)(void) = NULL;
+static struct pressure_t *pPressure = NULL;
+
+static int32_t values[SAMPLE_CHANNELS];
+static uint32_t readMs[SAMPLE_CHANNELS];
+static uint8_t valid = 0;
+static uint8_t fed = 0;			// channels filled by samples_put()
+static uint8_t updated = 0;		// channels read since samples_updated()
+
+// Adaptive rate
+static const uint32_t maxPeriodMs[SAMPLE_CHANNELS] = {
+	SAMPLE_MAX_PERIOD_TEMP_MS, SAMPLE_MAX_PERIOD_LIGHT_MS, SAMPLE_MAX_PERIOD_PRESSURE_MS
+};
+static const int32_t steps[SAMPLE_CHANNELS] = {
+	SAMPLE_STEP_TEMP, SAMPLE_STEP_LIGHT, SAMPLE_STEP_PRESSURE
+};
+static uint32_t periodMs[SAMPLE_CHANNELS];
+static int32_t reference[SAMPLE_CHANNELS];
+
+static uint32_t requests[SAMPLE_CHANNELS];
+static uint32_t reads[SAMPLE_CHANNELS];
+
+static int32_t light_step(void *pCtx)
+{
+	*(int32_t *)pCtx = (int32_t)record_u32(REC_LIGHT, light_read());
+	i2csched_account(LIGHT_READ_BYTES);
+	return I2CSCHED_DONE;
+}
+
+// Backs the period of channel off after a reading within its step taken
+// for the period (backOff), and goes back to the fastest rate after any
+// reading past it
+static void adapt(uint8_t ch, uint8_t backOff)
+{
+	int32_t step = steps[ch];
+	int32_t delta = values[ch] - reference[ch];
+
+	if (ch == SAMPLE_LIGHT && (values[ch] >> SAMPLE_STEP_LIGHT_SHIFT) > step)
+		step = values[ch] >> SAMPLE_STEP_LIGHT_SHIFT;
+	if (delta < 0)
+		delta = -delta;
+
+	if (delta > step)
+	{
+		periodMs[ch] = SAMPLE_MIN_PERIOD_MS;
+		reference[ch] = values[ch];
+	}
+	else if (backOff && periodMs[ch] < maxPeriodMs[ch])
+		periodMs[ch] = (periodMs[ch] * 2 < maxPeriodMs[ch]) ? periodMs[ch] * 2 : maxPeriodMs[ch];
+}
+
+void samples_init(uint32_t (*getMsTicks)(void), struct pressure_t *pPress)
+{
+	uint8_t ch;
+
+	pGetTicks = getMsTicks;
+	pPressure = pPress;
+	valid = 0;
+	fed = 0;
+	updated = 0;
+	for (ch = 0; ch < SAMPLE_CHANNELS; ch++)
+	{
+		values[ch] = 0;
+		periodMs[ch] = SAMPLE_MIN_PERIOD_MS;
+		requests[ch] = 0;
+		reads[ch] = 0;
+	}
+}
+
+uint8_t samples_refresh(uint8_t mask, uint32_t maxAgeMs)
+{
+	struct i2csched_job jobs[2];
+	uint8_t count = 0;
+	uint8_t stale = 0;
+	uint8_t ch;
+	uint32_t now;
+
+	if (pPressure == NULL)
+		mask &= ~SAMPLE_MASK(SAMPLE_PRESSURE);
+	mask &= ~fed;
+
+	// The REC_CLOCK records follow the clock read at once, see record.h
+	now = pGetTicks();
+	for (ch = 0; ch < SAMPLE_CHANNELS; ch++)
+	{
+		if (!(mask & SAMPLE_MASK(ch)))
+			continue;
+		requests[ch]++;
+		if (!(valid & SAMPLE_MASK(ch))
+			|| record_u8(REC_CLOCK, (now - readMs[ch])
+				>= ((maxAgeMs == SAMPLE_PERIOD) ? periodMs[ch] : maxAgeMs)))
+			stale |= SAMPLE_MASK(ch);
+	}
+	if (stale == 0)
+		return 0;
+
+	if (stale & SAMPLE_MASK(SAMPLE_TEMP))
+		values[SAMPLE_TEMP] = record_s32(REC_TEMP, temperature_read());
+
+	// BMP180 first: the light sensor is read during its conversion
+	if (stale & SAMPLE_MASK(SAMPLE_PRESSURE))
+	{
+		if (valid & SAMPLE_MASK(SAMPLE_TEMP))
+			pressure_note_temperature(pPressure, values[SAMPLE_TEMP]);
+		jobs[count].step = pressure_job_step;
+		jobs[count].pCtx = pPressure;
+		count++;
+	}
+	if (stale & SAMPLE_MASK(SAMPLE_LIGHT))
+	{
+		jobs[count].step = light_step;
+		jobs[count].pCtx = &values[SAMPLE_LIGHT];
+		count++;
+	}
+	if (count > 0)
+		i2csched_run(jobs, count);
+
+	// A reading lost on the bus stays stale, to be retried by the next call
+	if ((stale & SAMPLE_MASK(SAMPLE_PRESSURE)) && pPressure->failed)
+		stale &= ~SAMPLE_MASK(SAMPLE_PRESSURE);
+	if (stale & SAMPLE_MASK(SAMPLE_PRESSURE))
+		values[SAMPLE_PRESSURE] = pPressure->pressure;
+
+	for (ch = 0; ch < SAMPLE_CHANNELS; ch++)
+	{
+		if (stale & SAMPLE_MASK(ch))
+		{
+			// The first reading is the reference
+			// A consumer's tighter bound reads ahead of the period, which
+			// says nothing about how fast the channel changes
+			if (valid & SAMPLE_MASK(ch))
+				adapt(ch, maxAgeMs >= periodMs[ch]);
+			else
+				reference[ch] = values[ch];
+			readMs[ch] = now;
+			reads[ch]++;
+			metrics_add(METRIC_READS_TEMP + ch, 1);
+		}
+	}
+	valid |= stale;
+	updated |= stale;
+	return stale;
+}
+
+int32_t samples_get(uint8_t channel, uint32_t maxAgeMs)
+{
+	samples_refresh(SAMPLE_MASK(channel), maxAgeMs);
+	return values[channel];
+}
+
+void samples_put(uint8_t channel, int32_t value)
+{
+	values[channel] = value;
+	readMs[channel] = pGetTicks();
+	valid |= SAMPLE_MASK(channel);
+	fed |= SAMPLE_MASK(channel);
+	updated |= SAMPLE_MASK(channel);
+	metrics_add(METRIC_READS_TEMP + channel, 1);
+}
+
+uint8_t samples_updated(void)
+{
+	uint8_t mask = updated;
+
+	updated = 0;
+	return mask;
+}
+
+uint32_t samples_period(uint8_t channel)
+{
+	return periodMs[channel];
+}
+
+uint32_t samples_read_ms(uint8_t mask)
+{
+	uint32_t now = pGetTicks();
+	uint32_t oldest = now;
+	uint8_t ch;
+
+	for (ch = 0; ch < SAMPLE_CHANNELS; ch++)
+	{
+		if ((mask & valid & SAMPLE_MASK(ch)) && (now - readMs[ch]) > (now - oldest))
+			oldest = readMs[ch];
+	}
+	return oldest;
+}
+
+uint32_t samples_requests(uint8_t channel)
+{
+	return requests[channel];
+}
+
+uint32_t samples_reads(uint8_t channel)
+{
+	return reads[channel];
+}
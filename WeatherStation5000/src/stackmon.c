@@ -0,0 +1,39 @@
+#include "type.h"
+#include "../include/stackmon.h"
+
+// From the linker script
+extern unsigned long _data;
+extern unsigned long _ebss;
+extern void _vStackTop(void);
+
+void stackmon_paint(void)
+{
+	uint32_t *pWord = (uint32_t *)&_ebss;
+	uint32_t sp;
+
+	// Everything above sp is live: this frame and ResetISR's
+	__asm volatile ("mov %0, sp" : "=r" (sp));
+	while ((uint32_t)pWord < sp)
+		*pWord++ = STACKMON_PAINT;
+}
+
+uint32_t stackmon_size(void)
+{
+	return (uint32_t)&_vStackTop - (uint32_t)&_ebss;
+}
+
+uint32_t stackmon_peak(void)
+{
+	const uint32_t *pWord = (const uint32_t *)&_ebss;
+
+	// The stack grows down, so the first word up from _ebss that was
+	// overwritten is the deepest one reached
+	while ((uint32_t)pWord < (uint32_t)&_vStackTop && *pWord == STACKMON_PAINT)
+		pWord++;
+	return (uint32_t)&_vStackTop - (uint32_t)pWord;
+}
+
+uint32_t stackmon_static(void)
+{
+	return (uint32_t)&_ebss - (uint32_t)&_data;
+}
@@ -0,0 +1,187 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "uart.h"
+#include "../include/energy.h"
+#include "../include/frame.h"
+#include "../include/metrics.h"
+#include "../include/pressure.h"
+#include "../include/telemetry.h"
+
+static uint32_t lastSentMs = 0;
+static uint16_t seq = 0;
+static uint8_t sentAny = 0;
+
+static uint8_t calib[TLM_CALIB_SIZE];
+static uint8_t haveCalib = 0;
+static uint8_t sinceCalib = 0;
+
+// Sends a frame, counting its bytes for the energy model
+static uint32_t send(uint8_t type, const uint8_t *pPayload, uint8_t len)
+{
+	uint8_t frame[FRAME_MAX_SIZE];
+	uint32_t size = frame_encode(frame, type, pPayload, len);
+
+	UARTSend(frame, size);
+	energy_add_uart(size);
+	return size;
+}
+
+static uint16_t saturate_u16(uint32_t value)
+{
+	return (value > 0xFFFF) ? 0xFFFF : (uint16_t)value;
+}
+
+// Sends a sample frame, counting the longest periods gone by without one
+// as dropped, at the size of this frame
+static void send_sample(uint32_t ms, uint8_t type, const uint8_t *pPayload, uint8_t len)
+{
+	uint32_t periods = (ms - lastSentMs) / TELEMETRY_MAX_PERIOD_MS;
+	uint32_t size = send(type, pPayload, len);
+
+	if (sentAny && periods > 1)
+		metrics_add(METRIC_TLM_DROPPED, (periods - 1) * size);
+	lastSentMs = ms;
+	sentAny = 1;
+}
+
+void telemetry_init(void)
+{
+	sentAny = 0;
+	haveCalib = 0;
+}
+
+uint8_t telemetry_due(uint32_t ms)
+{
+	return !sentAny || (ms - lastSentMs) >= TELEMETRY_PERIOD_MS;
+}
+
+uint8_t telemetry_overdue(uint32_t ms)
+{
+	return !sentAny || (ms - lastSentMs) >= TELEMETRY_MAX_PERIOD_MS;
+}
+
+void telemetry_sample(uint32_t ms, int32_t temp, uint32_t lux, int32_t pressure)
+{
+	uint8_t payload[TLM_SAMPLE_SIZE];
+
+	if (!telemetry_due(ms))
+		return;
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	frame_put_u16(&payload[TLM_OFS_SEQ], seq++);
+	frame_put_u32(&payload[TLM_OFS_MS], ms);
+	frame_put_u16(&payload[TLM_OFS_TEMP], (uint16_t)(int16_t)temp);
+	frame_put_u32(&payload[TLM_OFS_LUX], lux);
+	frame_put_u32(&payload[TLM_OFS_PRESSURE], (uint32_t)pressure);
+
+	send_sample(ms, TLM_SAMPLE, payload, sizeof(payload));
+}
+
+void telemetry_calibration(const uint8_t *pProm, uint8_t oss)
+{
+	uint8_t i;
+
+	frame_put_u16(&calib[0], TELEMETRY_STATION_ID);
+	calib[TLM_OFS_CALIB_OSS] = oss;
+	for (i = 0; i < PRESSURE_PROM_SIZE; i++)
+		calib[TLM_OFS_CALIB_PROM + i] = pProm[i];
+
+	haveCalib = 1;
+	sinceCalib = TELEMETRY_CALIB_EVERY;
+}
+
+void telemetry_raw(uint32_t ms, int32_t temp, uint32_t lux, uint16_t ut, uint32_t up)
+{
+	uint8_t payload[TLM_RAW_SIZE];
+
+	if (!telemetry_due(ms))
+		return;
+
+	if (haveCalib && sinceCalib >= TELEMETRY_CALIB_EVERY)
+	{
+		send(TLM_CALIB, calib, sizeof(calib));
+		sinceCalib = 0;
+	}
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	frame_put_u16(&payload[TLM_OFS_SEQ], seq++);
+	frame_put_u32(&payload[TLM_OFS_MS], ms);
+	frame_put_u16(&payload[TLM_OFS_TEMP], (uint16_t)(int16_t)temp);
+	frame_put_u32(&payload[TLM_OFS_LUX], lux);
+	frame_put_u16(&payload[TLM_OFS_UT], ut);
+	frame_put_u32(&payload[TLM_OFS_UP], up);
+
+	send_sample(ms, TLM_RAW, payload, sizeof(payload));
+	sinceCalib++;
+}
+
+void telemetry_memory(uint16_t staticBytes, uint16_t stackBytes, uint16_t peakBytes)
+{
+	uint8_t payload[TLM_MEMORY_SIZE];
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	frame_put_u16(&payload[TLM_OFS_MEM_STATIC], staticBytes);
+	frame_put_u16(&payload[TLM_OFS_MEM_STACK], stackBytes);
+	frame_put_u16(&payload[TLM_OFS_MEM_PEAK], peakBytes);
+
+	send(TLM_MEMORY, payload, sizeof(payload));
+}
+
+void telemetry_clock(uint32_t fastMs, uint32_t idleMs, uint32_t switches)
+{
+	uint8_t payload[TLM_CLOCK_SIZE];
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	frame_put_u32(&payload[TLM_OFS_CLOCK_FAST], fastMs);
+	frame_put_u32(&payload[TLM_OFS_CLOCK_IDLE], idleMs);
+	frame_put_u32(&payload[TLM_OFS_CLOCK_SWITCHES], switches);
+
+	send(TLM_CLOCK, payload, sizeof(payload));
+}
+
+void telemetry_latency(uint8_t path, const struct latency_hist *pHist)
+{
+	uint8_t payload[TLM_LATENCY_SIZE];
+	uint8_t b;
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	payload[TLM_OFS_LAT_PATH] = path;
+	frame_put_u16(&payload[TLM_OFS_LAT_MAX], saturate_u16(pHist->maxMs));
+	for (b = 0; b < LATENCY_BUCKETS; b++)
+		frame_put_u16(&payload[TLM_OFS_LAT_COUNTS + 2 * b], saturate_u16(pHist->counts[b]));
+
+	send(TLM_LATENCY, payload, sizeof(payload));
+}
+
+void telemetry_metrics(void)
+{
+	uint8_t payload[TLM_METRICS_SIZE(TLM_METRICS_PER_FRAME)];
+	uint8_t first, count, i;
+
+	for (first = 0; first < METRICS; first += count)
+	{
+		count = (METRICS - first < TLM_METRICS_PER_FRAME) ? METRICS - first : TLM_METRICS_PER_FRAME;
+		frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+		payload[TLM_OFS_MET_FIRST] = first;
+		payload[TLM_OFS_MET_COUNT] = count;
+		for (i = 0; i < count; i++)
+			frame_put_u32(&payload[TLM_OFS_MET_VALUES + 4 * i], metrics_get(first + i));
+
+		send(TLM_METRICS, payload, TLM_METRICS_SIZE(count));
+	}
+}
+
+void telemetry_energy(const struct energy_report *pReport)
+{
+	uint8_t payload[TLM_ENERGY_SIZE];
+	uint8_t i;
+
+	frame_put_u16(&payload[TLM_OFS_STATION], TELEMETRY_STATION_ID);
+	frame_put_u32(&payload[TLM_OFS_EN_INTERVAL], pReport->intervalMs);
+	frame_put_u32(&payload[TLM_OFS_EN_SAMPLE], pReport->perSampleUj);
+	frame_put_u32(&payload[TLM_OFS_EN_HOUR], pReport->perHourUwh);
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		frame_put_u16(&payload[TLM_OFS_EN_POWER + 2 * i], saturate_u16(pReport->uw[i]));
+
+	send(TLM_ENERGY, payload, sizeof(payload));
+}
@@ -0,0 +1,86 @@
+#include "mcu_regs.h"
+#include "type.h"
+#include "gpio.h"
+#include "temp.h"
+#include "../include/clockmgr.h"
+#include "../include/gpioirq.h"
+#include "../include/temperature.h"
+
+#define TEMP_BIT		5		// PIO1_5
+#define TIMER_HZ		1000000
+
+// Interrupt state
+static uint32_t lastEdge;
+static uint32_t windowSum;
+static uint16_t windowPeriods;
+static uint8_t started = 0;
+
+// Published by the interrupt: one aligned word each, so the main loop reads
+// them without masking interrupts.
+static volatile uint32_t windowUs = 0;		// sum of the last full window
+static volatile uint32_t windows = 0;
+
+static void edge_isr(uint32_t pending, uint32_t level)
+{
+	uint32_t now = LPC_TMR32B1->TC;
+
+	if (started)
+	{
+		windowSum += now - lastEdge;
+		if (++windowPeriods == TEMPERATURE_WINDOW)
+		{
+			windowUs = windowSum;
+			windows++;
+			windowSum = 0;
+			windowPeriods = 0;
+		}
+	}
+	lastEdge = now;
+	started = 1;
+}
+
+// Keeps CT32B1 at 1 MHz across core clock switches. The prescale
+// counter restarts, so it cannot be left above a lower prescaler.
+static void clock_changed(uint32_t hz)
+{
+	LPC_TMR32B1->PR = hz / TIMER_HZ - 1;
+	LPC_TMR32B1->PC = 0;
+}
+
+void temperature_init(void)
+{
+	// CT32B1 free-running at 1 MHz
+	LPC_SYSCON->SYSAHBCLKCTRL |= (1 << 10);
+	LPC_TMR32B1->TCR = 0x02;
+	LPC_TMR32B1->PR = SystemCoreClock / TIMER_HZ - 1;
+	LPC_TMR32B1->MCR = 0;
+	LPC_TMR32B1->TCR = 0x01;
+
+	started = 0;
+	windowSum = 0;
+	windowPeriods = 0;
+	gpioirq_attach(PORT1, (1 << TEMP_BIT), GPIOIRQ_RISING, edge_isr);
+	clock_attach(clock_changed);
+}
+
+uint8_t temperature_ready(void)
+{
+	return windows != 0;
+}
+
+int32_t temperature_read(void)
+{
+	uint32_t periodUs;
+
+	if (!temperature_ready())
+		return temp_read();
+
+	// 10 T(C) = period (us) / scalar_div10 - 2731
+	periodUs = (windowUs + TEMPERATURE_WINDOW / 2) / TEMPERATURE_WINDOW;
+	return (int32_t)(periodUs / TEMPERATURE_SCALAR_DIV10) - 2731;
+}
+
+uint32_t temperature_count(void)
+{
+	return windows;
+}
@@ -0,0 +1,359 @@
+/*
+ * kernels.c
+ *
+ *  Checks and times the CPU-only firmware kernels on the host.
+ *
+ *      ws_kernel_bench [repetitions] [ms_per_repetition]
+ *
+ *  Every kernel is first checked against golden vectors: the Bosch
+ *  datasheet example calibration (ut 27898, up 23843 at OSS 0 give 15.0 C
+ *  and 69964 Pa) plus values frozen from the driver at every OSS, known
+ *  strings for the OLED and EEPROM formatting, and the UART divisor at
+ *  both core clocks (clockmgr.h). Any mismatch fails the run before
+ *  anything is timed.
+ *
+ *  Each kernel then runs one warm-up repetition and the given number of
+ *  timed ones, each long enough to take ms_per_repetition, and the time
+ *  per call is reported as min/median/mean/stddev. Compare the minimum
+ *  and median across builds, e.g. make -C host CFLAGS="-Os -g -Wall".
+ *
+ *  A new kernel (a filter, say) needs a golden check in check_golden()
+ *  and an entry in the kernels[] table.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../WeatherStation5000/include/bmp180.h"
+#include "../../WeatherStation5000/include/clockmgr.h"
+#include "../../WeatherStation5000/include/decimate.h"
+#include "../../WeatherStation5000/include/energy.h"
+#include "../../WeatherStation5000/include/format.h"
+#include "../../WeatherStation5000/include/latency.h"
+
+#define MAX_REPS	101
+#define INPUTS		1024		// power of two
+
+struct kernel {
+	const char *pName;
+	uint32_t (*run)(uint32_t calls);	// returns a checksum so nothing is optimised away
+};
+
+struct pressure_vector {
+	uint8_t oss;
+	uint16_t ut;
+	uint32_t up;
+	int16_t temperature;
+	int32_t b5;
+	int32_t pressure;
+};
+
+// Bosch BMP180 datasheet example
+static const struct bmp180_calib_param_t datasheet = {
+	408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868
+};
+
+static const struct pressure_vector pressureGolden[] = {
+	{0, 27898, 23843, 150, 2400, 69964},	// datasheet
+	{0, 25000, 24143, -121, -1938, 66576},
+	{0, 31000, 24443, 386, 6179, 75570},
+	{0, 28500, 24743, 198, 3173, 73441},
+	{1, 27898, 47681, 150, 2400, 69955},
+	{1, 25000, 47981, -121, -1938, 66147},
+	{1, 31000, 48281, 386, 6179, 74618},
+	{1, 28500, 48581, 198, 3173, 72073},
+	{2, 27898, 95389, 150, 2400, 69976},
+	{2, 25000, 95689, -121, -1938, 65955},
+	{2, 31000, 95989, 386, 6179, 74168},
+	{2, 28500, 96289, 198, 3173, 71417},
+	{3, 27898, 190845, 150, 2400, 70001},
+	{3, 25000, 191145, -121, -1938, 65873},
+	{3, 31000, 191445, 386, 6179, 73960},
+	{3, 28500, 191745, 198, 3173, 71101},
+};
+
+static int failures = 0;
+
+static struct bmp180_t dev;
+static uint32_t utIn[INPUTS];
+static uint32_t upIn[INPUTS];
+static int valueIn[INPUTS];
+static char snapshotIn[INPUTS][SNAPSHOT_SIZE];
+
+static void check(int condition, const char *pWhat)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", pWhat);
+		failures++;
+	}
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check_golden(void)
+{
+	struct decimate dec;
+	char snapshot[SNAPSHOT_SIZE];
+	uint8_t text[10];
+	int32_t temp, pressure;
+	uint32_t lux, out = 0;
+	size_t i;
+
+	memset(&dev, 0, sizeof(dev));
+	dev.calib_param = datasheet;
+	for (i = 0; i < sizeof(pressureGolden) / sizeof(pressureGolden[0]); i++)
+	{
+		const struct pressure_vector *pV = &pressureGolden[i];
+		char what[64];
+
+		dev.oversamp_setting = pV->oss;
+		snprintf(what, sizeof(what), "bmp180 vector %zu (oss %u, ut %u, up %u)",
+			i, pV->oss, pV->ut, pV->up);
+		check(bmp180_get_temperature(&dev, pV->ut) == pV->temperature, what);
+		check(dev.param_b5 == pV->b5, what);
+		check(bmp180_get_pressure(&dev, pV->up) == pV->pressure, what);
+	}
+
+	intToString(-123, text, 8, 10);
+	check(strcmp((char *)text, "-123") == 0, "intToString -123");
+	intToString(0, text, 8, 10);
+	check(strcmp((char *)text, "0") == 0, "intToString 0");
+	intToString(101325, text, 8, 10);
+	check(strcmp((char *)text, "101325") == 0, "intToString 101325");
+	intToString(255, text, 8, 16);
+	check(strcmp((char *)text, "ff") == 0, "intToString base 16");
+	strcpy((char *)text, "x");
+	intToString(123456, text, 4, 10);
+	check(strcmp((char *)text, "x") == 0, "intToString leaves a short buffer alone");
+	intToString(5, text, 8, 37);
+	check(strcmp((char *)text, "x") == 0, "intToString rejects base 37");
+
+	snapshot_encode(snapshot, 215, 1234, (const uint8_t *)"100650");
+	check(memcmp(snapshot, "765;215;1234;100650;\0\0\0\0\0\0\0\0\0\0\0", SNAPSHOT_SIZE) == 0,
+		"snapshot_encode layout");
+	check(snapshot_decode(snapshot, &temp, &lux, &pressure) == 1
+		&& temp == 215 && lux == 1234 && pressure == 100650, "snapshot round trip");
+	snapshot_encode(snapshot, -42, 0, (const uint8_t *)"empty");
+	check(snapshot_decode(snapshot, &temp, &lux, &pressure) == 1
+		&& temp == -42 && lux == 0 && pressure == 0, "snapshot with no pressure");
+	memset(snapshot, 0xFF, sizeof(snapshot));
+	check(snapshot_decode(snapshot, &temp, &lux, &pressure) == 0, "erased EEPROM holds no snapshot");
+
+	// 115200 baud within 1% at both core clocks
+	for (i = 0; i < 2; i++)
+	{
+		uint32_t pclk = i ? CLOCK_IRC_HZ : 72000000, mul, add, dl;
+		uint8_t fdr;
+		double baud;
+
+		dl = clock_uart_divisor(pclk, 115200, &fdr);
+		mul = fdr >> 4;
+		add = fdr & 0xF;
+		baud = pclk / (16.0 * dl * (1 + (double)add / mul));
+		check(dl > 0 && add < mul && fabs(baud / 115200 - 1) < 0.01,
+			i ? "UART divisor at 12 MHz" : "UART divisor at 72 MHz");
+	}
+
+	// Every ms lands in the bucket that starts at or below it
+	check(latency_bucket(0) == 0 && latency_bucket(1) == 1 && latency_bucket(2) == 2
+		&& latency_bucket(3) == 2 && latency_bucket(1023) == 10 && latency_bucket(1024) == 11
+		&& latency_bucket(0xFFFFFFFF) == LATENCY_BUCKETS - 1, "latency buckets");
+	for (i = 1; i < LATENCY_BUCKETS; i++)
+		check(latency_bucket(latency_bucket_ms(i)) == i
+			&& latency_bucket(latency_bucket_ms(i) - 1) == i - 1, "latency bucket edges");
+
+	// uA x s x V, without overflowing over a day at the largest current
+	check(energy_uj(ENERGY_BOARD, 1000000) == (uint64_t)ENERGY_UA_BOARD * ENERGY_SUPPLY_MV / 1000,
+		"energy of a second of the board");
+	check(energy_uj(ENERGY_CPU_FAST, 86400000000ULL)
+		== 86400ULL * ENERGY_UA_CPU_FAST * ENERGY_SUPPLY_MV / 1000, "energy of a day at the PLL");
+
+	// 4 inputs summed without dividing, then averaged
+	decimate_init(&dec, 2, 0);
+	check(!decimate_push(&dec, 23843, &out) && !decimate_push(&dec, 23844, &out)
+		&& !decimate_push(&dec, 23845, &out) && decimate_push(&dec, 23846, &out)
+		&& out == 95378, "decimate sum of 4");
+	decimate_init(&dec, 2, 2);
+	for (i = 0; i < 4; i++)
+		decimate_push(&dec, 100 + i, &out);
+	check(out == 101, "decimate average of 4");
+}
+
+static void make_inputs(void)
+{
+	uint32_t state = 12345;
+	size_t i;
+
+	for (i = 0; i < INPUTS; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		// Around the datasheet example, as a board at room temperature reads
+		utIn[i] = 27000 + state % 2000;
+		upIn[i] = 23000 + (state >> 11) % 2000;
+		valueIn[i] = (int)(state % 200000) - 1000;
+		snapshot_encode(snapshotIn[i], valueIn[i] % 500, state % 16000, (const uint8_t *)"101325");
+	}
+}
+
+static uint32_t run_temperature(uint32_t calls)
+{
+	uint32_t sum = 0, i;
+
+	for (i = 0; i < calls; i++)
+		sum += (uint32_t)bmp180_get_temperature(&dev, utIn[i & (INPUTS - 1)]);
+	return sum;
+}
+
+static uint32_t run_pressure(uint32_t calls)
+{
+	uint32_t sum = 0, i;
+
+	for (i = 0; i < calls; i++)
+		sum += (uint32_t)bmp180_get_pressure(&dev, upIn[i & (INPUTS - 1)]);
+	return sum;
+}
+
+static uint32_t run_int_to_string(uint32_t calls)
+{
+	uint8_t text[10];
+	uint32_t sum = 0, i;
+
+	for (i = 0; i < calls; i++)
+	{
+		intToString(valueIn[i & (INPUTS - 1)], text, sizeof(text), 10);
+		sum += text[0];
+	}
+	return sum;
+}
+
+static uint32_t run_snapshot_encode(uint32_t calls)
+{
+	char snapshot[SNAPSHOT_SIZE];
+	uint32_t sum = 0, i;
+
+	for (i = 0; i < calls; i++)
+	{
+		snapshot_encode(snapshot, valueIn[i & (INPUTS - 1)] % 500, i, (const uint8_t *)"101325");
+		sum += (uint8_t)snapshot[5];
+	}
+	return sum;
+}
+
+static uint32_t run_snapshot_decode(uint32_t calls)
+{
+	int32_t temp, pressure;
+	uint32_t lux, sum = 0, i;
+
+	for (i = 0; i < calls; i++)
+	{
+		snapshot_decode(snapshotIn[i & (INPUTS - 1)], &temp, &lux, &pressure);
+		sum += temp + lux + pressure;
+	}
+	return sum;
+}
+
+static uint32_t run_decimate(uint32_t calls)
+{
+	struct decimate dec;
+	uint32_t sum = 0, out, i;
+
+	decimate_init(&dec, 2, 0);
+	for (i = 0; i < calls; i++)
+	{
+		if (decimate_push(&dec, upIn[i & (INPUTS - 1)], &out))
+			sum += out;
+	}
+	return sum;
+}
+
+static const struct kernel kernels[] = {
+	{ "bmp180_get_temperature", run_temperature },
+	{ "bmp180_get_pressure", run_pressure },
+	{ "intToString", run_int_to_string },
+	{ "snapshot_encode", run_snapshot_encode },
+	{ "snapshot_decode", run_snapshot_decode },
+	{ "decimate_push", run_decimate },
+};
+
+static int compare_double(const void *pA, const void *pB)
+{
+	double a = *(const double *)pA, b = *(const double *)pB;
+
+	return (a > b) - (a < b);
+}
+
+static volatile uint32_t sink;
+
+static void bench(const struct kernel *pK, int reps, double repS)
+{
+	double ns[MAX_REPS];
+	double t0, t, mean = 0, var = 0;
+	uint32_t calls = 1024;
+	int r;
+
+	// Warm-up, and grow the call count until a repetition takes repS
+	for (;;)
+	{
+		t0 = now_s();
+		sink += pK->run(calls);
+		t = now_s() - t0;
+		if (t >= repS || calls >= 1u << 30)
+			break;
+		calls = (t > repS / 64) ? (uint32_t)(calls * repS / t) + 1 : calls * 64;
+	}
+
+	for (r = 0; r < reps; r++)
+	{
+		t0 = now_s();
+		sink += pK->run(calls);
+		ns[r] = (now_s() - t0) * 1e9 / calls;
+		mean += ns[r];
+	}
+	mean /= reps;
+	for (r = 0; r < reps; r++)
+		var += (ns[r] - mean) * (ns[r] - mean);
+	qsort(ns, reps, sizeof(ns[0]), compare_double);
+
+	printf("%-24s %10u %9.2f %9.2f %9.2f %9.2f\n", pK->pName, calls,
+		ns[0], ns[reps / 2], mean, sqrt(var / reps));
+}
+
+int main(int argc, char **argv)
+{
+	int reps = (argc > 1) ? atoi(argv[1]) : 15;
+	double repS = ((argc > 2) ? atof(argv[2]) : 20) / 1000;
+	size_t i;
+
+	if (reps < 1)
+		reps = 1;
+	if (reps > MAX_REPS)
+		reps = MAX_REPS;
+
+	check_golden();
+	printf("%s: golden vectors\n", failures ? "FAIL" : "PASS");
+	if (failures)
+		return 1;
+
+	make_inputs();
+	memset(&dev, 0, sizeof(dev));
+	dev.calib_param = datasheet;
+	dev.param_b5 = 2400;
+
+	printf("%d repetitions, ns per call\n", reps);
+	printf("%-24s %10s %9s %9s %9s %9s\n", "kernel", "calls/rep", "min", "median", "mean", "stddev");
+	for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+		bench(&kernels[i], reps, repS);
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * spsc_bench.c
+ *
+ *  Checks and measures the SPSC ring (WeatherStation5000/include/spsc.h).
+ *
+ *      ws_spsc_bench [elements]
+ *
+ *  First a few single-threaded checks of the edge cases (full, empty,
+ *  partial batches, index wrap at 2^32), then a producer and a consumer
+ *  thread stream a numbered sequence through the ring at several batch
+ *  sizes. The consumer checks every element arrives once and in order.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../WeatherStation5000/include/spsc.h"
+
+#define RING_CAPACITY	1024
+
+struct run {
+	struct spsc ring;
+	uint64_t slots[RING_CAPACITY];
+	uint64_t count;
+	uint32_t batch;
+	uint64_t errors;
+};
+
+static int failures = 0;
+
+static void check(int condition, const char *pWhat)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", pWhat);
+		failures++;
+	}
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check_edges(void)
+{
+	uint8_t slots[8];
+	uint8_t in[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	uint8_t out[16];
+	struct spsc ring;
+	uint32_t i;
+
+	check(spsc_init(&ring, slots, 1, 6) != 0, "rejects capacity 6");
+	check(spsc_init(&ring, slots, 1, 8) == 0, "accepts capacity 8");
+
+	check(spsc_pop(&ring, out, 1) == 0, "pop from empty ring");
+	check(spsc_push(&ring, in, 16) == 8, "push stops when full");
+	check(spsc_push(&ring, in, 1) == 0, "push into full ring");
+	check(spsc_count(&ring) == 8, "count when full");
+	check(spsc_pop(&ring, out, 3) == 3 && out[0] == 1 && out[2] == 3, "partial pop");
+	check(spsc_push(&ring, in + 8, 3) == 3, "push across the wrap");
+	check(spsc_pop(&ring, out, 16) == 8, "pop across the wrap");
+	for (i = 0; i < 8; i++)
+		check(out[i] == i + 4, "order across the wrap");
+
+	// Indices wrapping at 2^32
+	ring.head = ring.tail = 0xFFFFFFFCu;
+	check(spsc_push(&ring, in, 8) == 8, "push across the index wrap");
+	check(spsc_count(&ring) == 8, "count across the index wrap");
+	check(spsc_pop(&ring, out, 8) == 8 && out[0] == 1 && out[7] == 8, "pop across the index wrap");
+}
+
+static void *producer(void *pArg)
+{
+	struct run *pRun = pArg;
+	uint64_t buf[256];
+	uint64_t next = 0;
+	uint32_t n, i, done;
+
+	while (next < pRun->count)
+	{
+		n = pRun->batch;
+		if (n > pRun->count - next)
+			n = (uint32_t)(pRun->count - next);
+		for (i = 0; i < n; i++)
+			buf[i] = next + i;
+		done = 0;
+		while (done < n)
+		{
+			i = spsc_push(&pRun->ring, buf + done, n - done);
+			if (i == 0)
+				sched_yield();
+			done += i;
+		}
+		next += n;
+	}
+	return NULL;
+}
+
+static void *consumer(void *pArg)
+{
+	struct run *pRun = pArg;
+	uint64_t buf[256];
+	uint64_t expected = 0;
+	uint32_t n, i;
+
+	while (expected < pRun->count)
+	{
+		n = spsc_pop(&pRun->ring, buf, pRun->batch);
+		if (n == 0)
+			sched_yield();
+		for (i = 0; i < n; i++)
+		{
+			if (buf[i] != expected)
+				pRun->errors++;
+			expected++;
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t batches[] = { 1, 16, 256 };
+	static struct run run;
+	uint64_t count = (argc > 1) ? strtoull(argv[1], NULL, 0) : 20000000;
+	pthread_t prod, cons;
+	double t0, seconds;
+	unsigned b;
+
+	check_edges();
+
+	for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+	{
+		spsc_init(&run.ring, run.slots, sizeof(uint64_t), RING_CAPACITY);
+		run.count = count;
+		run.batch = batches[b];
+		run.errors = 0;
+
+		t0 = now_s();
+		pthread_create(&cons, NULL, consumer, &run);
+		pthread_create(&prod, NULL, producer, &run);
+		pthread_join(prod, NULL);
+		pthread_join(cons, NULL);
+		seconds = now_s() - t0;
+
+		check(run.errors == 0, "sequence through two threads");
+		printf("batch %3u: %" PRIu64 " elements, %" PRIu64 " out of order, %.1f M/s\n",
+			run.batch, count, run.errors, count / seconds / 1e6);
+	}
+
+	printf("%s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * archive.c
+ *
+ *  Block encoder and column decoder for the station archive (archive.h).
+ */
+
+#include <string.h>
+
+#include "archive.h"
+
+_Static_assert(sizeof(struct archive_block) % 8 == 0, "archive block header must stay 8-byte aligned");
+_Static_assert(sizeof(struct archive_calib) == 40, "archive calibration record layout");
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "archive headers are read in place");
+
+// Timestamps advance at a near-constant rate, so they are predicted from the
+// last two values; the other columns from the last value only.
+static const uint8_t colOrder2[COL_COUNT] = { 1, 1, 0, 0, 0, 0, 0, 0 };
+
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint32_t put_varint(uint8_t *pOut, uint64_t value)
+{
+	uint32_t len = 0;
+
+	while (value >= 0x80)
+	{
+		pOut[len++] = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	pOut[len++] = (uint8_t)value;
+	return len;
+}
+
+int64_t archive_sample_value(const struct sample *pSample, enum archive_column col)
+{
+	switch (col)
+	{
+	case COL_RX_MS:			return pSample->rxMs;
+	case COL_STATION_MS:	return pSample->stationMs;
+	case COL_SEQ:			return pSample->seq;
+	case COL_TEMP:			return pSample->temp;
+	case COL_LUX:			return pSample->lux;
+	case COL_PRESSURE:		return pSample->pressure;
+	case COL_UT:			return pSample->ut;
+	case COL_UP:			return pSample->up;
+	default:				return 0;
+	}
+}
+
+uint32_t archive_encode_block(uint8_t *pOut, uint16_t station,
+	const struct sample *pSamples, uint16_t count)
+{
+	struct archive_block *pBlock = (struct archive_block *)pOut;
+	uint32_t pos = sizeof(*pBlock);
+	uint32_t start, i;
+	int64_t value, prev, prev2, predicted;
+	int col;
+
+	memset(pBlock, 0, sizeof(*pBlock));
+	pBlock->magic = ARCHIVE_MAGIC;
+	pBlock->station = station;
+	pBlock->count = count;
+
+	for (col = 0; col < COL_COUNT; col++)
+	{
+		start = pos;
+		prev = prev2 = 0;
+		pBlock->min[col] = INT64_MAX;
+		pBlock->max[col] = INT64_MIN;
+
+		for (i = 0; i < count; i++)
+		{
+			value = archive_sample_value(&pSamples[i], col);
+			if (value < pBlock->min[col])
+				pBlock->min[col] = value;
+			if (value > pBlock->max[col])
+				pBlock->max[col] = value;
+
+			predicted = (colOrder2[col] && i > 1) ? 2 * prev - prev2 : prev;
+			pos += put_varint(&pOut[pos], zigzag(value - predicted));
+			prev2 = prev;
+			prev = value;
+		}
+		pBlock->colLen[col] = pos - start;
+	}
+
+	while (pos & 7)
+		pOut[pos++] = 0;
+	pBlock->size = pos;
+	return pos;
+}
+
+int archive_block_valid(const struct archive_block *pBlock, uint64_t avail)
+{
+	uint64_t total = sizeof(*pBlock);
+	int col;
+
+	if (avail < sizeof(*pBlock) || pBlock->magic != ARCHIVE_MAGIC)
+		return 0;
+	if (pBlock->size > avail || pBlock->count == 0 || pBlock->count > ARCHIVE_BLOCK_SAMPLES)
+		return 0;
+	for (col = 0; col < COL_COUNT; col++)
+		total += pBlock->colLen[col];
+	return total <= pBlock->size;
+}
+
+int archive_decode_column(const struct archive_block *pBlock, enum archive_column col,
+	int64_t *pOut)
+{
+	const uint8_t *pData = (const uint8_t *)(pBlock + 1);
+	const uint8_t *pEnd;
+	int64_t prev = 0, prev2 = 0, predicted;
+	uint64_t raw;
+	uint32_t shift, i;
+	int c;
+
+	for (c = 0; c < (int)col; c++)
+		pData += pBlock->colLen[c];
+	pEnd = pData + pBlock->colLen[col];
+
+	for (i = 0; i < pBlock->count; i++)
+	{
+		raw = 0;
+		shift = 0;
+		do
+		{
+			if (pData >= pEnd || shift > 63)
+				return -1;
+			raw |= (uint64_t)(*pData & 0x7F) << shift;
+			shift += 7;
+		} while (*pData++ & 0x80);
+
+		predicted = (colOrder2[col] && i > 1) ? 2 * prev - prev2 : prev;
+		pOut[i] = predicted + unzigzag(raw);
+		prev2 = prev;
+		prev = pOut[i];
+	}
+	return 0;
+}
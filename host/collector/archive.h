@@ -0,0 +1,84 @@
+/*
+ * archive.h
+ *
+ *  On-disk format of the station archive.
+ *
+ *  Each station has its own file, <dir>/station-<id>.wsa, holding a
+ *  sequence of self-contained blocks of up to ARCHIVE_BLOCK_SAMPLES
+ *  samples. A block is a fixed header followed by one encoded column per
+ *  sample field:
+ *
+ *      rx_ms, station_ms   delta-of-delta, zigzag varint
+ *      seq, temp, lux,     delta, zigzag varint
+ *      pressure, ut, up
+ *
+ *  The header carries the min/max of every column and each column's byte
+ *  length, so readers can skip whole blocks by range and decode only the
+ *  columns they need. Blocks are padded to 8 bytes and the header is
+ *  naturally aligned, so a mapped file can be read in place.
+ *  All fields are little-endian.
+ */
+
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#include <stdint.h>
+
+#include "storage.h"
+
+#define ARCHIVE_MAGIC			0x32425357		// "WSB2"
+#define ARCHIVE_BLOCK_SAMPLES	1024
+#define ARCHIVE_VARINT_MAX		10
+
+enum archive_column {
+	COL_RX_MS,
+	COL_STATION_MS,
+	COL_SEQ,
+	COL_TEMP,
+	COL_LUX,
+	COL_PRESSURE,
+	COL_UT,
+	COL_UP,
+	COL_COUNT
+};
+
+struct archive_block {
+	uint32_t magic;
+	uint16_t station;
+	uint16_t count;
+	uint32_t size;				// header + columns + padding
+	uint32_t colLen[COL_COUNT];	// encoded bytes per column, in column order
+	uint32_t reserved;
+	int64_t  min[COL_COUNT];
+	int64_t  max[COL_COUNT];
+};
+
+// Stations in raw telemetry mode also get <dir>/station-<id>.cal, one
+// record per calibration received, so archived ut/up can be recompensated.
+struct archive_calib {
+	int64_t  rxMs;
+	uint16_t station;
+	uint8_t  oss;
+	uint8_t  prom[22];			// as the BMP180 stores it, from 0xAA
+	uint8_t  reserved[7];
+};
+
+// Upper bound of an encoded block of count samples
+#define ARCHIVE_BLOCK_MAX(count)	(sizeof(struct archive_block) + \
+	(size_t)(count) * COL_COUNT * ARCHIVE_VARINT_MAX + 8)
+
+// Encodes samples[0..count) of one station into pOut. Returns the block size.
+uint32_t archive_encode_block(uint8_t *pOut, uint16_t station,
+	const struct sample *pSamples, uint16_t count);
+
+// Checks that a block header at pBlock fits in avail bytes.
+int archive_block_valid(const struct archive_block *pBlock, uint64_t avail);
+
+// Decodes one column of a block into pOut[0..count). Returns 0 on success.
+int archive_decode_column(const struct archive_block *pBlock, enum archive_column col,
+	int64_t *pOut);
+
+// Column value of a sample
+int64_t archive_sample_value(const struct sample *pSample, enum archive_column col);
+
+#endif /* ARCHIVE_H_ */
@@ -0,0 +1,148 @@
+/*
+ * archive_query.c
+ *
+ *  Bucketed range aggregates over mapped station files (archive_query.h).
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "archive_query.h"
+
+int archive_file_open(struct archive_file *pFile, const char *pPath)
+{
+	struct stat st;
+	void *pMap;
+
+	pFile->fd = open(pPath, O_RDONLY);
+	pFile->pBase = NULL;
+	pFile->size = 0;
+	if (pFile->fd < 0 || fstat(pFile->fd, &st) != 0)
+	{
+		perror(pPath);
+		return -1;
+	}
+	if (st.st_size == 0)
+		return 0;
+
+	pMap = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, pFile->fd, 0);
+	if (pMap == MAP_FAILED)
+	{
+		perror(pPath);
+		close(pFile->fd);
+		pFile->fd = -1;
+		return -1;
+	}
+	madvise(pMap, (size_t)st.st_size, MADV_SEQUENTIAL);
+	pFile->pBase = pMap;
+	pFile->size = (uint64_t)st.st_size;
+	return 0;
+}
+
+void archive_file_close(struct archive_file *pFile)
+{
+	if (pFile->pBase != NULL)
+		munmap((void *)pFile->pBase, pFile->size);
+	if (pFile->fd >= 0)
+		close(pFile->fd);
+	pFile->pBase = NULL;
+	pFile->fd = -1;
+}
+
+static int block_skippable(const struct archive_block *pBlock, const struct archive_query *pQuery)
+{
+	if (pBlock->max[COL_RX_MS] < pQuery->fromMs || pBlock->min[COL_RX_MS] > pQuery->toMs)
+		return 1;
+	if (pBlock->max[pQuery->column] < pQuery->valueMin || pBlock->min[pQuery->column] > pQuery->valueMax)
+		return 1;
+	return 0;
+}
+
+int archive_query_run(const struct archive_file *pFile, const struct archive_query *pQuery,
+	archive_bucket_fn onBucket, void *pUser, struct archive_query_stats *pStats)
+{
+	int64_t times[ARCHIVE_BLOCK_SAMPLES];
+	int64_t values[ARCHIVE_BLOCK_SAMPLES];
+	const struct archive_block *pBlock;
+	struct archive_bucket bucket;
+	uint64_t offset = 0;
+	int64_t startMs, value;
+	uint32_t i;
+	int result = 0;
+
+	bucket.count = 0;
+	while (offset < pFile->size)
+	{
+		pBlock = (const struct archive_block *)(pFile->pBase + offset);
+		if (!archive_block_valid(pBlock, pFile->size - offset))
+		{
+			result = -1;
+			break;
+		}
+		offset += pBlock->size;
+		pStats->blocks++;
+
+		if (block_skippable(pBlock, pQuery))
+		{
+			pStats->blocksSkipped++;
+			continue;
+		}
+		if (archive_decode_column(pBlock, COL_RX_MS, times) != 0 ||
+			archive_decode_column(pBlock, pQuery->column, values) != 0)
+		{
+			result = -1;
+			break;
+		}
+		pStats->samplesDecoded += pBlock->count;
+		pStats->bytesDecoded += pBlock->colLen[COL_RX_MS] + pBlock->colLen[pQuery->column];
+
+		for (i = 0; i < pBlock->count; i++)
+		{
+			value = values[i];
+			if (times[i] < pQuery->fromMs || times[i] > pQuery->toMs ||
+				value < pQuery->valueMin || value > pQuery->valueMax)
+				continue;
+
+			if (pQuery->bucketMs > 0)
+			{
+				startMs = times[i] % pQuery->bucketMs;
+				startMs = times[i] - (startMs < 0 ? startMs + pQuery->bucketMs : startMs);
+			}
+			else
+				startMs = (bucket.count > 0) ? bucket.startMs : times[i];
+
+			if (bucket.count > 0 && bucket.startMs != startMs)
+			{
+				onBucket(&bucket, pUser);
+				bucket.count = 0;
+			}
+			if (bucket.count == 0)
+			{
+				bucket.station = pBlock->station;
+				bucket.startMs = startMs;
+				bucket.min = value;
+				bucket.max = value;
+				bucket.sum = 0;
+			}
+			if (value < bucket.min)
+				bucket.min = value;
+			if (value > bucket.max)
+				bucket.max = value;
+			bucket.sum += (double)value;
+			bucket.count++;
+			// Latest by receive time, whatever the order in the file
+			if (bucket.count == 1 || times[i] >= bucket.lastMs)
+			{
+				bucket.last = value;
+				bucket.lastMs = times[i];
+			}
+		}
+	}
+
+	if (bucket.count > 0)
+		onBucket(&bucket, pUser);
+	return result;
+}
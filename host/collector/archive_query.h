@@ -0,0 +1,62 @@
+/*
+ * archive_query.h
+ *
+ *  Read path over the station archive (archive.h). Station files are
+ *  mapped, not read: blocks outside the time range or value range are
+ *  skipped on their header alone, and only the time column and the queried
+ *  column of the remaining blocks are decoded.
+ */
+
+#ifndef ARCHIVE_QUERY_H_
+#define ARCHIVE_QUERY_H_
+
+#include <stdint.h>
+
+#include "archive.h"
+
+struct archive_file {
+	int fd;
+	const uint8_t *pBase;
+	uint64_t size;
+};
+
+struct archive_query {
+	enum archive_column column;
+	int64_t fromMs;				// rx_ms range, inclusive
+	int64_t toMs;
+	int64_t bucketMs;			// aligned to the epoch; 0: one bucket for the range
+	int64_t valueMin;			// only samples with value in range count
+	int64_t valueMax;
+};
+
+struct archive_bucket {
+	uint16_t station;
+	int64_t  startMs;
+	uint32_t count;
+	int64_t  min;
+	int64_t  max;
+	double   sum;
+	int64_t  last;
+	int64_t  lastMs;
+};
+
+struct archive_query_stats {
+	uint64_t blocks;
+	uint64_t blocksSkipped;
+	uint64_t samplesDecoded;
+	uint64_t bytesDecoded;
+};
+
+typedef void (*archive_bucket_fn)(const struct archive_bucket *pBucket, void *pUser);
+
+// Returns 0 on success. An empty file maps to size 0.
+int  archive_file_open(struct archive_file *pFile, const char *pPath);
+void archive_file_close(struct archive_file *pFile);
+
+// Aggregates one station file. Buckets are reported in file order, each
+// as soon as it is complete. Returns 0, or -1 if the file is damaged;
+// blocks before the damage are still reported.
+int archive_query_run(const struct archive_file *pFile, const struct archive_query *pQuery,
+	archive_bucket_fn onBucket, void *pUser, struct archive_query_stats *pStats);
+
+#endif /* ARCHIVE_QUERY_H_ */
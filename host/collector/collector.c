@@ -0,0 +1,571 @@
+/*
+ * collector.c
+ *
+ *  Fleet telemetry collector. Reads the UART streams of many stations
+ *  (serial ports, pseudo-terminals or Unix socket connections), decodes
+ *  their frames and hands the samples to storage.
+ *
+ *  Streams are sharded round-robin over a pool of worker threads. Each
+ *  worker owns an epoll set, reads and decodes its own streams, and pushes
+ *  decoded samples into its own bounded SPSC ring, and the calibrations of
+ *  raw-mode stations into a second, smaller one. A single storage thread
+ *  drains all rings and does all file I/O. No locks are taken on the data
+ *  path.
+ *
+ *  Stations in raw telemetry mode send their BMP180 calibration and raw
+ *  ut/up; the worker compensates them with the Bosch algorithm and stores
+ *  the raw values alongside.
+ *
+ *      ws_collector [-w workers] [-o out] [-l socket] [-s secs] [-e] [tty ...]
+ *
+ *  -w  worker threads (default: online CPUs)
+ *  -o  archive directory (default: ./archive)
+ *  -l  also accept station streams on this Unix socket
+ *  -s  print statistics every secs seconds
+ *  -e  exit once every stream has closed (no -l)
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "storage.h"
+#include "../compensate/bmp180_batch.h"
+#include "../../WeatherStation5000/include/frame.h"
+#include "../../WeatherStation5000/include/spsc.h"
+#include "../../WeatherStation5000/include/telemetry.h"
+
+#define MAX_WORKERS			64
+#define RING_CAPACITY		8192
+#define CALIB_CAPACITY		64
+#define READ_CHUNK			4096
+#define EVENTS_PER_WAIT		256
+#define SAMPLE_BATCH		256
+
+struct stream {
+	int fd;
+	struct frame_decoder dec;
+	uint16_t lastSeq;
+	uint8_t haveSeq;
+	uint8_t haveCalib;
+	struct bmp180_batch calib;
+};
+
+struct worker_stats {
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t badFrames;
+	uint64_t samples;
+	uint64_t lost;			// gaps in station sequence numbers
+	uint64_t stalls;		// ring full, waited for storage
+	uint64_t uncalibrated;	// raw samples before any calibration frame
+};
+
+struct worker {
+	pthread_t thread;
+	int epfd;
+	struct spsc ring;
+	struct sample *pSlots;
+	struct spsc calibRing;
+	struct archive_calib calibSlots[CALIB_CAPACITY];
+	struct worker_stats stats;
+};
+
+static struct worker workers[MAX_WORKERS];
+static int workerCount = 0;
+static int nextWorker = 0;
+static int activeStreams = 0;
+
+static volatile sig_atomic_t stopRequested = 0;
+static int workersStop = 0;
+static int storageStop = 0;
+
+//------------------------------------------------------------------------
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void stat_add(uint64_t *pCounter, uint64_t value)
+{
+	__atomic_store_n(pCounter, __atomic_load_n(pCounter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static void on_signal(int sig)
+{
+	stopRequested = 1;
+}
+
+//------------------------------------------------------------------------
+static void close_stream(struct worker *pWorker, struct stream *pStream)
+{
+	epoll_ctl(pWorker->epfd, EPOLL_CTL_DEL, pStream->fd, NULL);
+	close(pStream->fd);
+	free(pStream);
+	__atomic_sub_fetch(&activeStreams, 1, __ATOMIC_RELEASE);
+}
+
+static int add_stream(int fd)
+{
+	struct worker *pWorker = &workers[nextWorker];
+	struct stream *pStream = calloc(1, sizeof(*pStream));
+	struct epoll_event ev;
+
+	if (pStream == NULL)
+		return -1;
+
+	nextWorker = (nextWorker + 1) % workerCount;
+	pStream->fd = fd;
+	frame_decoder_init(&pStream->dec);
+
+	__atomic_add_fetch(&activeStreams, 1, __ATOMIC_RELEASE);
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	ev.data.ptr = pStream;
+	if (epoll_ctl(pWorker->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		perror("epoll_ctl");
+		__atomic_sub_fetch(&activeStreams, 1, __ATOMIC_RELEASE);
+		free(pStream);
+		return -1;
+	}
+	return 0;
+}
+
+static void flush_samples(struct worker *pWorker, struct sample *pBatch, uint32_t count)
+{
+	size_t done = 0;
+
+	while (done < count)
+	{
+		done += spsc_push(&pWorker->ring, pBatch + done, count - done);
+		if (done < count)
+		{
+			stat_add(&pWorker->stats.stalls, 1);
+			sched_yield();
+		}
+	}
+	stat_add(&pWorker->stats.samples, count);
+}
+
+static void on_calibration(struct worker *pWorker, struct stream *pStream, const uint8_t *pPayload,
+	int64_t rxMs)
+{
+	struct bmp180_calib_param_t *pC = &pStream->calib.calib;
+	struct archive_calib record;
+	const uint8_t *pProm = &pPayload[TLM_OFS_CALIB_PROM];
+	int16_t words[11];
+	int i;
+
+	for (i = 0; i < 11; i++)
+		words[i] = (int16_t)(pProm[2 * i] << 8 | pProm[2 * i + 1]);
+
+	// Repeats of the calibration the stream already has change nothing
+	memset(&record, 0, sizeof(record));
+	record.rxMs = rxMs;
+	record.station = frame_get_u16(&pPayload[TLM_OFS_STATION]);
+	record.oss = pPayload[TLM_OFS_CALIB_OSS];
+	memcpy(record.prom, pProm, sizeof(record.prom));
+	if (pStream->haveCalib && pStream->calib.oss == record.oss &&
+		pC->ac1 == words[0] && pC->ac2 == words[1] && pC->ac3 == words[2] &&
+		pC->ac4 == (uint16_t)words[3] && pC->ac5 == (uint16_t)words[4] && pC->ac6 == (uint16_t)words[5] &&
+		pC->b1 == words[6] && pC->b2 == words[7] && pC->mb == words[8] &&
+		pC->mc == words[9] && pC->md == words[10])
+		return;
+
+	pC->ac1 = words[0];
+	pC->ac2 = words[1];
+	pC->ac3 = words[2];
+	pC->ac4 = (uint16_t)words[3];
+	pC->ac5 = (uint16_t)words[4];
+	pC->ac6 = (uint16_t)words[5];
+	pC->b1 = words[6];
+	pC->b2 = words[7];
+	pC->mb = words[8];
+	pC->mc = words[9];
+	pC->md = words[10];
+	pStream->calib.oss = record.oss & 3;
+	pStream->calib.b5 = 0;
+	pStream->haveCalib = 1;
+
+	// Rare, so waiting for storage here costs the data path nothing
+	while (spsc_push(&pWorker->calibRing, &record, 1) == 0)
+	{
+		stat_add(&pWorker->stats.stalls, 1);
+		sched_yield();
+	}
+}
+
+static uint32_t parse_bytes(struct worker *pWorker, struct stream *pStream, const uint8_t *pData,
+	size_t len, int64_t rxMs, struct sample *pOut)
+{
+	uint32_t produced = 0;
+	struct frame_decoder *pDec = &pStream->dec;
+	struct sample *pSample;
+	uint64_t frames = 0, bad = 0, lost = 0, uncalibrated = 0;
+	uint32_t ut;
+	int16_t temp;
+	int8_t result;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		result = frame_decoder_feed(pDec, pData[i]);
+		if (result == FRAME_ERROR)
+		{
+			bad++;
+			continue;
+		}
+		if (result != FRAME_READY)
+			continue;
+
+		frames++;
+		if (pDec->type == TLM_CALIB && pDec->len == TLM_CALIB_SIZE)
+		{
+			on_calibration(pWorker, pStream, pDec->payload, rxMs);
+			continue;
+		}
+		if (!(pDec->type == TLM_SAMPLE && pDec->len == TLM_SAMPLE_SIZE) &&
+			!(pDec->type == TLM_RAW && pDec->len == TLM_RAW_SIZE))
+			continue;
+
+		pSample = &pOut[produced++];
+		pSample->rxMs = rxMs;
+		pSample->station = frame_get_u16(&pDec->payload[TLM_OFS_STATION]);
+		pSample->seq = frame_get_u16(&pDec->payload[TLM_OFS_SEQ]);
+		pSample->stationMs = frame_get_u32(&pDec->payload[TLM_OFS_MS]);
+		pSample->temp = (int16_t)frame_get_u16(&pDec->payload[TLM_OFS_TEMP]);
+		pSample->lux = frame_get_u32(&pDec->payload[TLM_OFS_LUX]);
+		if (pDec->type == TLM_SAMPLE)
+		{
+			pSample->pressure = (int32_t)frame_get_u32(&pDec->payload[TLM_OFS_PRESSURE]);
+			pSample->ut = 0;
+			pSample->up = 0;
+		}
+		else
+		{
+			// Kept raw even without a calibration, for later reprocessing
+			ut = frame_get_u16(&pDec->payload[TLM_OFS_UT]);
+			pSample->ut = (uint16_t)ut;
+			pSample->up = frame_get_u32(&pDec->payload[TLM_OFS_UP]);
+			pSample->pressure = BMP180_INVALID_DATA;
+			if (pStream->haveCalib)
+				bmp180_batch_compensate_scalar(&pStream->calib, &ut, &pSample->up,
+					1, &temp, &pSample->pressure);
+			else
+				uncalibrated++;
+		}
+
+		if (pStream->haveSeq)
+			lost += (uint16_t)(pSample->seq - pStream->lastSeq - 1);
+		pStream->lastSeq = pSample->seq;
+		pStream->haveSeq = 1;
+
+		if (produced == SAMPLE_BATCH)
+		{
+			flush_samples(pWorker, pOut, produced);
+			produced = 0;
+		}
+	}
+
+	stat_add(&pWorker->stats.frames, frames);
+	stat_add(&pWorker->stats.badFrames, bad);
+	stat_add(&pWorker->stats.lost, lost);
+	stat_add(&pWorker->stats.uncalibrated, uncalibrated);
+	return produced;
+}
+
+static void *worker_main(void *pArg)
+{
+	struct worker *pWorker = pArg;
+	struct epoll_event events[EVENTS_PER_WAIT];
+	struct sample batch[SAMPLE_BATCH];
+	uint8_t buf[READ_CHUNK];
+	struct stream *pStream;
+	uint32_t pending;
+	int64_t rxMs;
+	ssize_t got;
+	int n, i;
+
+	while (!__atomic_load_n(&workersStop, __ATOMIC_ACQUIRE))
+	{
+		n = epoll_wait(pWorker->epfd, events, EVENTS_PER_WAIT, 100);
+		if (n <= 0)
+			continue;
+
+		rxMs = now_ms();
+		for (i = 0; i < n; i++)
+		{
+			pStream = events[i].data.ptr;
+			got = read(pStream->fd, buf, sizeof(buf));
+			if (got > 0)
+			{
+				stat_add(&pWorker->stats.bytes, (uint64_t)got);
+				pending = parse_bytes(pWorker, pStream, buf, (size_t)got, rxMs, batch);
+				if (pending > 0)
+					flush_samples(pWorker, batch, pending);
+			}
+			else if (got == 0 || (errno != EAGAIN && errno != EINTR))
+			{
+				// EOF, or EIO once the far side of a pty has gone away
+				close_stream(pWorker, pStream);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------
+static void *storage_main(void *pArg)
+{
+	struct sample batch[SAMPLE_BATCH];
+	struct archive_calib calib;
+	struct timespec idle = { 0, 1000000 };
+	int64_t lastFlush = now_ms();
+	size_t got, total;
+	int i, stop;
+
+	for (;;)
+	{
+		stop = __atomic_load_n(&storageStop, __ATOMIC_ACQUIRE);
+		total = 0;
+		for (i = 0; i < workerCount; i++)
+		{
+			while (spsc_pop(&workers[i].calibRing, &calib, 1) > 0)
+			{
+				storage_calibration(&calib);
+				total++;
+			}
+			while ((got = spsc_pop(&workers[i].ring, batch, SAMPLE_BATCH)) > 0)
+			{
+				storage_append(batch, (uint32_t)got);
+				total += got;
+			}
+		}
+
+		if (total == 0)
+		{
+			if (stop)
+				break;
+			nanosleep(&idle, NULL);
+		}
+		if (now_ms() - lastFlush >= 1000)
+		{
+			storage_flush();
+			lastFlush = now_ms();
+		}
+	}
+
+	storage_flush();
+	return NULL;
+}
+
+//------------------------------------------------------------------------
+static int open_tty(const char *pPath)
+{
+	struct termios tio;
+	int fd = open(pPath, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+	if (fd < 0)
+	{
+		perror(pPath);
+		return -1;
+	}
+
+	if (isatty(fd))
+	{
+		tcgetattr(fd, &tio);
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, B115200);
+		cfsetospeed(&tio, B115200);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
+
+static int open_listener(const char *pPath)
+{
+	struct sockaddr_un addr;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, pPath, sizeof(addr.sun_path) - 1);
+	unlink(pPath);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0)
+	{
+		perror(pPath);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void print_stats(void)
+{
+	struct worker_stats total;
+	struct worker_stats *pS;
+	int i;
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < workerCount; i++)
+	{
+		pS = &workers[i].stats;
+		total.bytes += __atomic_load_n(&pS->bytes, __ATOMIC_RELAXED);
+		total.frames += __atomic_load_n(&pS->frames, __ATOMIC_RELAXED);
+		total.badFrames += __atomic_load_n(&pS->badFrames, __ATOMIC_RELAXED);
+		total.samples += __atomic_load_n(&pS->samples, __ATOMIC_RELAXED);
+		total.lost += __atomic_load_n(&pS->lost, __ATOMIC_RELAXED);
+		total.stalls += __atomic_load_n(&pS->stalls, __ATOMIC_RELAXED);
+		total.uncalibrated += __atomic_load_n(&pS->uncalibrated, __ATOMIC_RELAXED);
+	}
+
+	fprintf(stderr, "streams %d bytes %" PRIu64 " frames %" PRIu64 " bad %" PRIu64
+		" samples %" PRIu64 " lost %" PRIu64 " stalls %" PRIu64 " uncalibrated %" PRIu64 "\n",
+		__atomic_load_n(&activeStreams, __ATOMIC_ACQUIRE), total.bytes, total.frames,
+		total.badFrames, total.samples, total.lost, total.stalls, total.uncalibrated);
+}
+
+static void usage(const char *pName)
+{
+	fprintf(stderr, "usage: %s [-w workers] [-o out] [-l socket] [-s secs] [-e] [tty ...]\n", pName);
+}
+
+int main(int argc, char **argv)
+{
+	const char *pOutPath = NULL;
+	const char *pSocketPath = NULL;
+	pthread_t storageThread;
+	struct pollfd pfd;
+	int statsSecs = 0;
+	int exitIdle = 0;
+	int64_t lastStats;
+	int listenFd = -1;
+	int opt, i, fd;
+
+	workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, "w:o:l:s:e")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w': workerCount = atoi(optarg); break;
+		case 'o': pOutPath = optarg; break;
+		case 'l': pSocketPath = optarg; break;
+		case 's': statsSecs = atoi(optarg); break;
+		case 'e': exitIdle = 1; break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (workerCount < 1)
+		workerCount = 1;
+	if (workerCount > MAX_WORKERS)
+		workerCount = MAX_WORKERS;
+	if (optind == argc && pSocketPath == NULL)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (storage_open(pOutPath) != 0)
+		return 1;
+
+	for (i = 0; i < workerCount; i++)
+	{
+		workers[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+		workers[i].pSlots = malloc(RING_CAPACITY * sizeof(struct sample));
+		if (workers[i].epfd < 0 || workers[i].pSlots == NULL ||
+			spsc_init(&workers[i].ring, workers[i].pSlots, sizeof(struct sample), RING_CAPACITY) != 0 ||
+			spsc_init(&workers[i].calibRing, workers[i].calibSlots, sizeof(struct archive_calib),
+				CALIB_CAPACITY) != 0)
+		{
+			perror("worker");
+			return 1;
+		}
+	}
+
+	for (i = optind; i < argc; i++)
+	{
+		fd = open_tty(argv[i]);
+		if (fd >= 0 && add_stream(fd) != 0)
+			close(fd);
+	}
+	if (pSocketPath != NULL && (listenFd = open_listener(pSocketPath)) < 0)
+		return 1;
+
+	for (i = 0; i < workerCount; i++)
+		pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+	pthread_create(&storageThread, NULL, storage_main, NULL);
+
+	lastStats = now_ms();
+	pfd.fd = listenFd;
+	pfd.events = POLLIN;
+	while (!stopRequested)
+	{
+		if (poll(&pfd, listenFd >= 0 ? 1 : 0, 100) > 0)
+		{
+			while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+			{
+				if (add_stream(fd) != 0)
+					close(fd);
+			}
+		}
+
+		if (exitIdle && listenFd < 0 && __atomic_load_n(&activeStreams, __ATOMIC_ACQUIRE) == 0)
+			break;
+		if (statsSecs > 0 && now_ms() - lastStats >= (int64_t)statsSecs * 1000)
+		{
+			print_stats();
+			lastStats = now_ms();
+		}
+	}
+
+	__atomic_store_n(&workersStop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < workerCount; i++)
+		pthread_join(workers[i].thread, NULL);
+	__atomic_store_n(&storageStop, 1, __ATOMIC_RELEASE);
+	pthread_join(storageThread, NULL);
+
+	storage_close();
+	print_stats();
+
+	if (listenFd >= 0)
+	{
+		close(listenFd);
+		unlink(pSocketPath);
+	}
+	for (i = 0; i < workerCount; i++)
+	{
+		close(workers[i].epfd);
+		free(workers[i].pSlots);
+	}
+	return 0;
+}
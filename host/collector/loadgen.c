@@ -0,0 +1,178 @@
+/*
+ * loadgen.c
+ *
+ *  Load generator for ws_collector. Opens a number of pseudo-terminal
+ *  pairs, prints the station side of each, and writes synthetic telemetry
+ *  frames into them as a fleet of stations would.
+ *
+ *      ws_loadgen [-n stations] [-r rate_hz] [-d seconds] [-w delay_ms] [-R]
+ *
+ *  -R sends raw telemetry (calibration plus ut/up) instead of compensated
+ *  samples, using the BMP180 datasheet calibration.
+ *
+ *  Typical use:
+ *
+ *      build/ws_loadgen -n 256 -r 50 -d 10 > ptys &
+ *      sleep 0.2; build/ws_collector -e -o archive $(cat ptys)
+ *      build/ws_query -d archive
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../WeatherStation5000/include/frame.h"
+#include "../../WeatherStation5000/include/telemetry.h"
+
+// BMP180 datasheet example: ut 27898, up 23843 at OSS 0 give 15.0 C, 69964 Pa
+static const uint8_t datasheetProm[22] = {
+	0x01, 0x98, 0xFF, 0xB8, 0xC7, 0xD1, 0x7F, 0xE5, 0x7F, 0xF5, 0x5A, 0x71,
+	0x18, 0x2E, 0x00, 0x04, 0x80, 0x00, 0xDD, 0xF9, 0x0B, 0x34
+};
+
+struct station {
+	int fd;
+	uint16_t seq;
+};
+
+// Encodes a calibration frame into pOut; returns its length
+static uint32_t put_calibration(uint8_t *pOut, uint16_t station)
+{
+	uint8_t payload[TLM_CALIB_SIZE];
+
+	frame_put_u16(&payload[TLM_OFS_STATION], station);
+	payload[TLM_OFS_CALIB_OSS] = 0;
+	memcpy(&payload[TLM_OFS_CALIB_PROM], datasheetProm, sizeof(datasheetProm));
+	return frame_encode(pOut, TLM_CALIB, payload, TLM_CALIB_SIZE);
+}
+
+static int64_t mono_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int open_station(struct station *pStation)
+{
+	struct termios tio;
+	const char *pName;
+	int slave;
+
+	pStation->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (pStation->fd < 0 || grantpt(pStation->fd) != 0 || unlockpt(pStation->fd) != 0)
+		return -1;
+	pName = ptsname(pStation->fd);
+
+	// Put the line discipline in raw mode before anything is written so the
+	// frames arrive unmodified whoever opens the station side.
+	slave = open(pName, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+		return -1;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	close(slave);
+
+	printf("%s\n", pName);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct station *pStations;
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+	uint8_t frame[2 * FRAME_MAX_SIZE];
+	unsigned long written = 0, dropped = 0;
+	int stations = 16, rate = 10, seconds = 10, delayMs = 500;
+	int64_t start, next, period;
+	uint32_t ms, len;
+	int raw = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:r:d:w:R")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': stations = atoi(optarg); break;
+		case 'r': rate = atoi(optarg); break;
+		case 'd': seconds = atoi(optarg); break;
+		case 'w': delayMs = atoi(optarg); break;
+		case 'R': raw = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-n stations] [-r rate_hz] [-d seconds] [-w delay_ms] [-R]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (stations < 1 || rate < 1)
+		return 2;
+
+	pStations = calloc((size_t)stations, sizeof(*pStations));
+	for (i = 0; i < stations; i++)
+	{
+		if (open_station(&pStations[i]) != 0)
+		{
+			perror("pty");
+			return 1;
+		}
+	}
+	fflush(stdout);
+	usleep((useconds_t)delayMs * 1000);
+
+	period = 1000000 / rate;
+	start = mono_us();
+	next = start;
+	while (next - start < (int64_t)seconds * 1000000)
+	{
+		ms = (uint32_t)((next - start) / 1000);
+		for (i = 0; i < stations; i++)
+		{
+			frame_put_u16(&payload[TLM_OFS_STATION], (uint16_t)(i + 1));
+			frame_put_u16(&payload[TLM_OFS_SEQ], pStations[i].seq);
+			frame_put_u32(&payload[TLM_OFS_MS], ms);
+			frame_put_u16(&payload[TLM_OFS_TEMP], (uint16_t)(200 + (i + ms / 1000) % 50));
+			frame_put_u32(&payload[TLM_OFS_LUX], (uint32_t)(i * 10 + ms % 1000));
+			if (!raw)
+			{
+				frame_put_u32(&payload[TLM_OFS_PRESSURE], (uint32_t)(101325 - i - ms % 200));
+				len = frame_encode(frame, TLM_SAMPLE, payload, TLM_SAMPLE_SIZE);
+			}
+			else
+			{
+				len = 0;
+				if (pStations[i].seq % TELEMETRY_CALIB_EVERY == 0)
+					len = put_calibration(frame, (uint16_t)(i + 1));
+				frame_put_u16(&payload[TLM_OFS_UT], 27898);
+				frame_put_u32(&payload[TLM_OFS_UP], (uint32_t)(23843 + i % 16));
+				len += frame_encode(frame + len, TLM_RAW, payload, TLM_RAW_SIZE);
+			}
+
+			// A station whose pty is full loses the frame, as a UART would.
+			if (write(pStations[i].fd, frame, len) == (ssize_t)len)
+				written++;
+			else
+				dropped++;
+			pStations[i].seq++;
+		}
+
+		next += period;
+		while (mono_us() < next)
+			usleep(200);
+	}
+
+	// Give the collector time to drain before the ptys hang up.
+	usleep((useconds_t)delayMs * 1000);
+	for (i = 0; i < stations; i++)
+		close(pStations[i].fd);
+	fprintf(stderr, "frames written %lu dropped %lu\n", written, dropped);
+	free(pStations);
+	return 0;
+}
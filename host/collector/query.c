@@ -0,0 +1,137 @@
+/*
+ * query.c
+ *
+ *  Range aggregates over a station archive written by ws_collector.
+ *
+ *      ws_query [-d dir] [-c column] [-f from_ms] [-t to_ms] [-b bucket_ms]
+ *               [-m min] [-M max] [station ...]
+ *
+ *  Prints one CSV row per station and bucket with the count, min, max,
+ *  mean and last value of the column (default: pressure). Without station
+ *  ids every station in the archive is queried.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "archive_query.h"
+
+static const char *columnNames[COL_COUNT] = {
+	"rx_ms", "station_ms", "seq", "temp", "lux", "pressure", "ut", "up"
+};
+
+static void print_bucket(const struct archive_bucket *pBucket, void *pUser)
+{
+	printf("%u,%" PRId64 ",%u,%" PRId64 ",%" PRId64 ",%.2f,%" PRId64 "\n",
+		pBucket->station, pBucket->startMs, pBucket->count, pBucket->min, pBucket->max,
+		pBucket->sum / pBucket->count, pBucket->last);
+}
+
+static int query_station(const char *pDir, unsigned station, const struct archive_query *pQuery,
+	struct archive_query_stats *pStats)
+{
+	struct archive_file file;
+	char path[512];
+	int result;
+
+	snprintf(path, sizeof(path), "%s/station-%u.wsa", pDir, station);
+	if (archive_file_open(&file, path) != 0)
+		return -1;
+	result = archive_query_run(&file, pQuery, print_bucket, NULL, pStats);
+	if (result != 0)
+		fprintf(stderr, "%s: damaged block, rest of file ignored\n", path);
+	archive_file_close(&file);
+	return result;
+}
+
+static int parse_column(const char *pName)
+{
+	int col;
+
+	for (col = 0; col < COL_COUNT; col++)
+		if (strcmp(pName, columnNames[col]) == 0)
+			return col;
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	struct archive_query query = {
+		COL_PRESSURE, INT64_MIN, INT64_MAX, 0, INT64_MIN, INT64_MAX
+	};
+	struct archive_query_stats stats = { 0 };
+	const char *pDir = "archive";
+	struct timespec t0, t1;
+	struct dirent *pEnt;
+	unsigned station;
+	DIR *pDirHandle;
+	int opt, col, i;
+	int failed = 0, nameLen;
+
+	while ((opt = getopt(argc, argv, "d:c:f:t:b:m:M:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': pDir = optarg; break;
+		case 'c':
+			if ((col = parse_column(optarg)) < 0)
+			{
+				fprintf(stderr, "unknown column %s\n", optarg);
+				return 2;
+			}
+			query.column = col;
+			break;
+		case 'f': query.fromMs = strtoll(optarg, NULL, 0); break;
+		case 't': query.toMs = strtoll(optarg, NULL, 0); break;
+		case 'b': query.bucketMs = strtoll(optarg, NULL, 0); break;
+		case 'm': query.valueMin = strtoll(optarg, NULL, 0); break;
+		case 'M': query.valueMax = strtoll(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-d dir] [-c column] [-f from_ms] [-t to_ms] [-b bucket_ms]"
+				" [-m min] [-M max] [station ...]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (query.bucketMs < 0)
+		return 2;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	printf("station,bucket_ms,count,min,max,mean,last\n");
+	if (optind < argc)
+	{
+		for (i = optind; i < argc; i++)
+			failed |= query_station(pDir, (unsigned)atoi(argv[i]), &query, &stats);
+	}
+	else
+	{
+		pDirHandle = opendir(pDir);
+		if (pDirHandle == NULL)
+		{
+			perror(pDir);
+			return 1;
+		}
+		while ((pEnt = readdir(pDirHandle)) != NULL)
+		{
+			// The whole name, so the station-<n>.cal files next to them do not match
+			nameLen = 0;
+			if (sscanf(pEnt->d_name, "station-%u.wsa%n", &station, &nameLen) == 1 &&
+				nameLen > 0 && pEnt->d_name[nameLen] == '\0')
+				failed |= query_station(pDir, station, &query, &stats);
+		}
+		closedir(pDirHandle);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	fprintf(stderr, "blocks %" PRIu64 " skipped %" PRIu64 " samples %" PRIu64
+		" decoded %" PRIu64 " bytes in %.3f ms\n",
+		stats.blocks, stats.blocksSkipped, stats.samplesDecoded, stats.bytesDecoded,
+		(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * storage.c
+ *
+ *  Columnar station archive (see archive.h). Samples are buffered per
+ *  station and written as one compressed block when the buffer fills, when
+ *  its oldest sample has waited ARCHIVE_MAX_AGE_MS, or on close.
+ *
+ *  Only the storage thread calls in here.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "storage.h"
+
+#define ARCHIVE_MAX_AGE_MS	(10 * 60 * 1000)
+#define STATION_IDS			65536
+
+struct station_buf {
+	uint16_t station;
+	uint16_t count;
+	struct sample samples[ARCHIVE_BLOCK_SAMPLES];
+};
+
+static char archiveDir[256];
+static struct station_buf **ppStations = NULL;	// indexed by station id
+static uint16_t *pActive = NULL;				// station ids with a buffer
+static uint32_t activeCount = 0;
+static uint8_t *pBlockBuf = NULL;
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void write_block(struct station_buf *pBuf)
+{
+	char path[300];
+	uint32_t size;
+	int fd;
+
+	if (pBuf->count == 0)
+		return;
+
+	size = archive_encode_block(pBlockBuf, pBuf->station, pBuf->samples, pBuf->count);
+	pBuf->count = 0;
+
+	// Blocks go out in a single append so a reader never sees half a header.
+	snprintf(path, sizeof(path), "%s/station-%u.wsa", archiveDir, pBuf->station);
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd < 0 || write(fd, pBlockBuf, size) != (ssize_t)size)
+		perror(path);
+	if (fd >= 0)
+		close(fd);
+}
+
+void storage_calibration(const struct archive_calib *pCalib)
+{
+	char path[300];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/station-%u.cal", archiveDir, pCalib->station);
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd < 0 || write(fd, pCalib, sizeof(*pCalib)) != (ssize_t)sizeof(*pCalib))
+		perror(path);
+	if (fd >= 0)
+		close(fd);
+}
+
+int storage_open(const char *pPath)
+{
+	if (pPath == NULL)
+		pPath = "archive";
+	if (mkdir(pPath, 0755) != 0 && errno != EEXIST)
+	{
+		perror(pPath);
+		return -1;
+	}
+	snprintf(archiveDir, sizeof(archiveDir), "%s", pPath);
+
+	ppStations = calloc(STATION_IDS, sizeof(*ppStations));
+	pActive = calloc(STATION_IDS, sizeof(*pActive));
+	pBlockBuf = malloc(ARCHIVE_BLOCK_MAX(ARCHIVE_BLOCK_SAMPLES));
+	if (ppStations == NULL || pActive == NULL || pBlockBuf == NULL)
+		return -1;
+	return 0;
+}
+
+void storage_append(const struct sample *pSamples, uint32_t count)
+{
+	struct station_buf *pBuf;
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		pBuf = ppStations[pSamples[i].station];
+		if (pBuf == NULL)
+		{
+			pBuf = malloc(sizeof(*pBuf));
+			if (pBuf == NULL)
+				continue;
+			pBuf->station = pSamples[i].station;
+			pBuf->count = 0;
+			ppStations[pBuf->station] = pBuf;
+			pActive[activeCount++] = pBuf->station;
+		}
+
+		pBuf->samples[pBuf->count++] = pSamples[i];
+		if (pBuf->count == ARCHIVE_BLOCK_SAMPLES)
+			write_block(pBuf);
+	}
+}
+
+void storage_flush(void)
+{
+	int64_t now = now_ms();
+	struct station_buf *pBuf;
+	uint32_t i;
+
+	for (i = 0; i < activeCount; i++)
+	{
+		pBuf = ppStations[pActive[i]];
+		if (pBuf->count > 0 && now - pBuf->samples[0].rxMs >= ARCHIVE_MAX_AGE_MS)
+			write_block(pBuf);
+	}
+}
+
+void storage_close(void)
+{
+	uint32_t i;
+
+	if (ppStations == NULL)
+		return;
+
+	for (i = 0; i < activeCount; i++)
+	{
+		write_block(ppStations[pActive[i]]);
+		free(ppStations[pActive[i]]);
+	}
+	free(ppStations);
+	free(pActive);
+	free(pBlockBuf);
+	ppStations = NULL;
+	pActive = NULL;
+	pBlockBuf = NULL;
+	activeCount = 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * storage.h
+ *
+ *  Where the collector's storage thread puts decoded samples: the
+ *  columnar station archive of archive.h.
+ */
+
+#ifndef STORAGE_H_
+#define STORAGE_H_
+
+#include <stdint.h>
+
+struct sample {
+	int64_t  rxMs;			// host receive time, ms since the epoch
+	uint32_t stationMs;		// station uptime ticks
+	uint16_t station;
+	uint16_t seq;
+	int32_t  temp;			// 0.1 C
+	uint32_t lux;
+	int32_t  pressure;		// Pa
+	uint16_t ut;			// raw BMP180 conversions, 0 unless the
+	uint32_t up;			// station sends raw telemetry
+};
+
+struct archive_calib;
+
+// pPath names the archive directory (default "archive"); returns 0 on success.
+int  storage_open(const char *pPath);
+void storage_append(const struct sample *pSamples, uint32_t count);
+void storage_flush(void);
+
+// Records a station's BMP180 calibration.
+void storage_calibration(const struct archive_calib *pCalib);
+void storage_close(void);
+
+#endif /* STORAGE_H_ */
@@ -0,0 +1,190 @@
+/*
+ * bench.c
+ *
+ *  Checks the batch compensation paths against the Bosch driver
+ *  (WeatherStation5000/src/bmp180.c) and measures their throughput.
+ *
+ *      ws_bmp180_batch [samples] [threads]
+ *
+ *  Every calibration set is run through the driver one sample at a time
+ *  and through the scalar, AVX2 and threaded batch paths; any difference
+ *  in temperature, pressure or the final b5 fails the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bmp180_batch.h"
+
+#define CALIB_SETS	64
+
+static uint32_t rngState = 12345;
+
+static uint32_t rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_calib(int set, struct bmp180_batch *pBatch)
+{
+	// Set 0 is the datasheet example, the rest random around real parts
+	static const struct bmp180_calib_param_t datasheet = {
+		408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868
+	};
+	struct bmp180_calib_param_t *pC = &pBatch->calib;
+
+	*pC = datasheet;
+	if (set > 0)
+	{
+		pC->ac1 = (int16_t)rng();
+		pC->ac2 = (int16_t)rng();
+		pC->ac3 = (int16_t)rng();
+		pC->ac4 = (uint16_t)rng();
+		pC->ac5 = (uint16_t)rng();
+		pC->ac6 = (uint16_t)rng();
+		pC->b1 = (int16_t)rng();
+		pC->b2 = (int16_t)rng();
+		pC->mc = (int16_t)rng();
+		pC->md = (int16_t)rng();
+	}
+	// Exercise the divisor checks
+	if (set % 8 == 3)
+		pC->md = 0;
+	if (set % 8 == 5)
+		pC->ac4 = 0;
+	pBatch->oss = (int16_t)(set % 4);
+	pBatch->b5 = (int32_t)(rng() % 8000);
+}
+
+static void make_raw(const struct bmp180_batch *pBatch, uint32_t *pUt, uint32_t *pUp, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		pUt[i] = rng() & 0xFFFF;
+		pUp[i] = (rng() & 0x7FFFF) >> (3 - pBatch->oss);
+		// Zero divisors: x1 == 0 with md == 0, or x1 == -md
+		if (rng() % 64 == 0)
+			pUt[i] = pBatch->calib.ac6;
+	}
+}
+
+// The driver one sample at a time
+static void reference(const struct bmp180_batch *pBatch, const uint32_t *pUt, const uint32_t *pUp,
+	size_t count, int16_t *pTemp, int32_t *pPressure, int32_t *pB5)
+{
+	struct bmp180_t dev;
+	int32_t x1;
+	size_t i;
+
+	memset(&dev, 0, sizeof(dev));
+	dev.calib_param = pBatch->calib;
+	dev.oversamp_setting = pBatch->oss;
+	dev.param_b5 = pBatch->b5;
+	for (i = 0; i < count; i++)
+	{
+		// The driver would divide by zero here; the batch code defines it as invalid
+		x1 = (int32_t)((uint32_t)((int32_t)pUt[i] - dev.calib_param.ac6) * dev.calib_param.ac5) >> 15;
+		if (x1 != 0 && x1 + dev.calib_param.md == 0)
+			pTemp[i] = BMP180_INVALID_DATA;
+		else
+			pTemp[i] = bmp180_get_temperature(&dev, pUt[i]);
+		pPressure[i] = bmp180_get_pressure(&dev, pUp[i]);
+	}
+	*pB5 = dev.param_b5;
+}
+
+static int compare(const char *pName, int set, size_t count, const int16_t *pRefT, const int32_t *pRefP,
+	int32_t refB5, const int16_t *pT, const int32_t *pP, int32_t b5)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (pRefT[i] != pT[i] || pRefP[i] != pP[i])
+		{
+			printf("FAIL %s set %d sample %zu: temp %d/%d pressure %d/%d\n", pName, set, i,
+				pRefT[i], pT[i], pRefP[i], pP[i]);
+			return 1;
+		}
+	}
+	if (refB5 != b5)
+	{
+		printf("FAIL %s set %d: b5 %d/%d\n", pName, set, refB5, b5);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1 << 20;
+	int threads = (argc > 2) ? atoi(argv[2]) : 0;
+	uint32_t *pUt = malloc(count * sizeof(*pUt));
+	uint32_t *pUp = malloc(count * sizeof(*pUp));
+	int16_t *pRefT = malloc(count * sizeof(*pRefT));
+	int32_t *pRefP = malloc(count * sizeof(*pRefP));
+	int16_t *pT = malloc(count * sizeof(*pT));
+	int32_t *pP = malloc(count * sizeof(*pP));
+	struct bmp180_batch base, batch;
+	double tRef = 0, tScalar = 0, tAvx2 = 0, tMt = 0, t0;
+	int32_t refB5;
+	int avx2 = bmp180_batch_have_avx2();
+	int set, failed = 0;
+
+	if (pUt == NULL || pUp == NULL || pRefT == NULL || pRefP == NULL || pT == NULL || pP == NULL)
+		return 1;
+
+	for (set = 0; set < CALIB_SETS && !failed; set++)
+	{
+		make_calib(set, &base);
+		make_raw(&base, pUt, pUp, count);
+
+		t0 = now_s();
+		reference(&base, pUt, pUp, count, pRefT, pRefP, &refB5);
+		tRef += now_s() - t0;
+
+		batch = base;
+		t0 = now_s();
+		bmp180_batch_compensate_scalar(&batch, pUt, pUp, count, pT, pP);
+		tScalar += now_s() - t0;
+		failed |= compare("scalar", set, count, pRefT, pRefP, refB5, pT, pP, batch.b5);
+
+		if (avx2)
+		{
+			batch = base;
+			t0 = now_s();
+			bmp180_batch_compensate_avx2(&batch, pUt, pUp, count, pT, pP);
+			tAvx2 += now_s() - t0;
+			failed |= compare("avx2", set, count, pRefT, pRefP, refB5, pT, pP, batch.b5);
+		}
+
+		batch = base;
+		t0 = now_s();
+		bmp180_batch_compensate_mt(&batch, pUt, pUp, count, pT, pP, threads);
+		tMt += now_s() - t0;
+		failed |= compare("threaded", set, count, pRefT, pRefP, refB5, pT, pP, batch.b5);
+	}
+
+	printf("%s: %d calibration sets x %zu samples\n", failed ? "FAIL" : "PASS", set, count);
+	printf("driver    %8.1f Msamples/s\n", set * count / tRef / 1e6);
+	printf("scalar    %8.1f Msamples/s\n", set * count / tScalar / 1e6);
+	if (avx2)
+		printf("avx2      %8.1f Msamples/s\n", set * count / tAvx2 / 1e6);
+	printf("threaded  %8.1f Msamples/s\n", set * count / tMt / 1e6);
+	return failed;
+}
@@ -0,0 +1,334 @@
+/*
+ * bmp180_batch.c
+ *
+ *  Batch BMP180 compensation (bmp180_batch.h).
+ *
+ *  The driver's signed arithmetic wraps on the LPC1343, so everything here
+ *  multiplies and adds in 32 bits with the same wrap-around. AVX2 has no
+ *  integer division; the 32-bit quotients are taken in double precision,
+ *  which is exact: for |a|, |b| < 2^32 the rounding error of a/b is below
+ *  2^-21/|b|, closer than any non-integer quotient gets to an integer.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bmp180_batch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_HAVE_X86	1
+#endif
+
+// Below this many samples per thread, threads cost more than they save
+#define MT_MIN_CHUNK	(64 * 1024)
+
+//------------------------------------------------------------------------
+// Scalar reference, step for step as bmp180_get_temperature/_pressure
+static inline int32_t mul32(int32_t a, int32_t b)
+{
+	return (int32_t)((uint32_t)a * (uint32_t)b);
+}
+
+static inline int32_t add32(int32_t a, int32_t b)
+{
+	return (int32_t)((uint32_t)a + (uint32_t)b);
+}
+
+// Returns 0 and leaves *pB5 alone when the divisor is zero
+static inline int scalar_b5(const struct bmp180_calib_param_t *pCalib, uint32_t ut, int32_t *pB5)
+{
+	int32_t x1, den;
+
+	x1 = mul32((int32_t)ut - (int32_t)pCalib->ac6, (int32_t)pCalib->ac5) >> 15;
+	den = add32(x1, pCalib->md);
+	if (den == 0)
+		return 0;
+	*pB5 = add32(x1, ((int32_t)pCalib->mc << 11) / den);
+	return 1;
+}
+
+static inline int32_t scalar_pressure(const struct bmp180_calib_param_t *pCalib, int16_t oss,
+	int32_t b5, uint32_t up)
+{
+	int32_t b6, b6sq, x1, x2, x3, b3, p;
+	uint32_t b4, b7;
+
+	b6 = add32(b5, -4000);
+	b6sq = mul32(b6, b6) >> 12;
+	x1 = mul32(b6sq, pCalib->b2) >> 11;
+	x2 = mul32(pCalib->ac2, b6) >> 11;
+	x3 = add32(x1, x2);
+	b3 = add32((int32_t)((uint32_t)add32((int32_t)pCalib->ac1 * 4, x3) << oss), 2) >> 2;
+
+	x1 = mul32(pCalib->ac3, b6) >> 13;
+	x2 = mul32(pCalib->b1, b6sq) >> 16;
+	x3 = add32(add32(x1, x2), 2) >> 2;
+	b4 = ((uint32_t)pCalib->ac4 * (uint32_t)add32(x3, 32768)) >> 15;
+
+	b7 = (up - (uint32_t)b3) * (uint32_t)(50000 >> oss);
+	if (b4 == BMP180_CHECK_DIVISOR)
+		return BMP180_INVALID_DATA;
+	if (b7 < 0x80000000)
+		p = (int32_t)((b7 << 1) / b4);
+	else
+		p = (int32_t)((b7 / b4) << 1);
+
+	x1 = p >> 8;
+	x1 = mul32(x1, x1);
+	x1 = mul32(x1, BMP180_PARAM_MG) >> 16;
+	x2 = mul32(p, BMP180_PARAM_MH) >> 16;
+	return add32(p, add32(add32(x1, x2), BMP180_PARAM_MI) >> 4);
+}
+
+void bmp180_batch_compensate_scalar(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure)
+{
+	int32_t b5 = pBatch->b5;
+	size_t i;
+	int valid;
+
+	for (i = 0; i < count; i++)
+	{
+		valid = scalar_b5(&pBatch->calib, pUt[i], &b5);
+		if (pTemp != NULL)
+			pTemp[i] = valid ? (int16_t)(add32(b5, BMP180_CALCULATE_TRUE_TEMPERATURE) >> 4) : BMP180_INVALID_DATA;
+		if (pPressure != NULL)
+			pPressure[i] = scalar_pressure(&pBatch->calib, pBatch->oss, b5, pUp[i]);
+	}
+	pBatch->b5 = b5;
+}
+
+//------------------------------------------------------------------------
+#ifdef BATCH_HAVE_X86
+
+int bmp180_batch_have_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Signed 32-bit a / b, truncated, for b != 0 and a quotient that fits
+static AVX2 inline __m256i avx2_sdiv(__m256i a, __m256i b)
+{
+	__m128i lo = _mm256_cvttpd_epi32(_mm256_div_pd(
+		_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(b))));
+	__m128i hi = _mm256_cvttpd_epi32(_mm256_div_pd(
+		_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1))));
+
+	return _mm256_set_m128i(hi, lo);
+}
+
+static AVX2 inline __m256d avx2_u32_to_pd(__m128i v)
+{
+	return _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(v, _mm_set1_epi32(INT32_MIN))),
+		_mm256_set1_pd(2147483648.0));
+}
+
+static AVX2 inline __m128i avx2_pd_to_u32(__m256d v)
+{
+	v = _mm256_sub_pd(_mm256_floor_pd(v), _mm256_set1_pd(2147483648.0));
+	return _mm_xor_si128(_mm256_cvttpd_epi32(v), _mm_set1_epi32(INT32_MIN));
+}
+
+// Unsigned 32-bit a / b, for b != 0
+static AVX2 inline __m256i avx2_udiv(__m256i a, __m256i b)
+{
+	__m128i lo = avx2_pd_to_u32(_mm256_div_pd(
+		avx2_u32_to_pd(_mm256_castsi256_si128(a)), avx2_u32_to_pd(_mm256_castsi256_si128(b))));
+	__m128i hi = avx2_pd_to_u32(_mm256_div_pd(
+		avx2_u32_to_pd(_mm256_extracti128_si256(a, 1)), avx2_u32_to_pd(_mm256_extracti128_si256(b, 1))));
+
+	return _mm256_set_m128i(hi, lo);
+}
+
+AVX2 void bmp180_batch_compensate_avx2(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure)
+{
+	const struct bmp180_calib_param_t *pCalib = &pBatch->calib;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i ac1x4 = _mm256_set1_epi32((int32_t)pCalib->ac1 * 4);
+	const __m256i ac2 = _mm256_set1_epi32(pCalib->ac2);
+	const __m256i ac3 = _mm256_set1_epi32(pCalib->ac3);
+	const __m256i ac4 = _mm256_set1_epi32(pCalib->ac4);
+	const __m256i ac5 = _mm256_set1_epi32(pCalib->ac5);
+	const __m256i ac6 = _mm256_set1_epi32(pCalib->ac6);
+	const __m256i b1 = _mm256_set1_epi32(pCalib->b1);
+	const __m256i b2 = _mm256_set1_epi32(pCalib->b2);
+	const __m256i md = _mm256_set1_epi32(pCalib->md);
+	const __m256i mc = _mm256_set1_epi32((int32_t)pCalib->mc << 11);
+	const __m256i ossScale = _mm256_set1_epi32(50000 >> pBatch->oss);
+	const __m128i oss = _mm_cvtsi32_si128(pBatch->oss);
+	int32_t b5Lanes[8];
+	int32_t carry = pBatch->b5;
+	__m256i x1, x2, x3, den, bad, b5, b6, b6sq, b3, b4, b7, b7High, p;
+	size_t i;
+	int mask, j;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		// Temperature
+		x1 = _mm256_srai_epi32(_mm256_mullo_epi32(
+			_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)&pUt[i]), ac6), ac5), 15);
+		den = _mm256_add_epi32(x1, md);
+		bad = _mm256_cmpeq_epi32(den, zero);
+		den = _mm256_or_si256(den, _mm256_and_si256(bad, one));
+		b5 = _mm256_add_epi32(x1, avx2_sdiv(mc, den));
+
+		mask = _mm256_movemask_ps(_mm256_castsi256_ps(bad));
+		if (mask != 0)
+		{
+			// Invalid lanes keep the b5 before them, in sample order
+			_mm256_storeu_si256((__m256i *)b5Lanes, b5);
+			for (j = 0; j < 8; j++)
+			{
+				if (mask & (1 << j))
+					b5Lanes[j] = carry;
+				carry = b5Lanes[j];
+			}
+			b5 = _mm256_loadu_si256((const __m256i *)b5Lanes);
+		}
+		else
+			carry = _mm256_extract_epi32(b5, 7);
+
+		if (pTemp != NULL)
+		{
+			x1 = _mm256_srai_epi32(_mm256_add_epi32(b5, _mm256_set1_epi32(BMP180_CALCULATE_TRUE_TEMPERATURE)), 4);
+			x1 = _mm256_andnot_si256(bad, x1);
+			// Keep the low 16 bits of each lane, as the cast to s16 does
+			x1 = _mm256_and_si256(x1, _mm256_set1_epi32(0xFFFF));
+			x1 = _mm256_permute4x64_epi64(_mm256_packus_epi32(x1, x1), 0x08);
+			_mm_storeu_si128((__m128i *)&pTemp[i], _mm256_castsi256_si128(x1));
+		}
+		if (pPressure == NULL)
+			continue;
+
+		// B3
+		b6 = _mm256_sub_epi32(b5, _mm256_set1_epi32(4000));
+		b6sq = _mm256_srai_epi32(_mm256_mullo_epi32(b6, b6), 12);
+		x1 = _mm256_srai_epi32(_mm256_mullo_epi32(b6sq, b2), 11);
+		x2 = _mm256_srai_epi32(_mm256_mullo_epi32(ac2, b6), 11);
+		x3 = _mm256_add_epi32(x1, x2);
+		b3 = _mm256_srai_epi32(_mm256_add_epi32(
+			_mm256_sll_epi32(_mm256_add_epi32(ac1x4, x3), oss), _mm256_set1_epi32(2)), 2);
+
+		// B4
+		x1 = _mm256_srai_epi32(_mm256_mullo_epi32(ac3, b6), 13);
+		x2 = _mm256_srai_epi32(_mm256_mullo_epi32(b1, b6sq), 16);
+		x3 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(x1, x2), _mm256_set1_epi32(2)), 2);
+		b4 = _mm256_srli_epi32(_mm256_mullo_epi32(ac4, _mm256_add_epi32(x3, _mm256_set1_epi32(32768))), 15);
+
+		// B7 and the divide; both branches of b7 < 0x80000000 share one division
+		b7 = _mm256_mullo_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)&pUp[i]), b3), ossScale);
+		bad = _mm256_cmpeq_epi32(b4, zero);
+		b4 = _mm256_or_si256(b4, _mm256_and_si256(bad, one));
+		b7High = _mm256_srai_epi32(b7, 31);
+		p = avx2_udiv(_mm256_blendv_epi8(_mm256_slli_epi32(b7, 1), b7, b7High), b4);
+		p = _mm256_blendv_epi8(p, _mm256_slli_epi32(p, 1), b7High);
+
+		x1 = _mm256_srai_epi32(p, 8);
+		x1 = _mm256_mullo_epi32(x1, x1);
+		x1 = _mm256_srai_epi32(_mm256_mullo_epi32(x1, _mm256_set1_epi32(BMP180_PARAM_MG)), 16);
+		x2 = _mm256_srai_epi32(_mm256_mullo_epi32(p, _mm256_set1_epi32(BMP180_PARAM_MH)), 16);
+		p = _mm256_add_epi32(p, _mm256_srai_epi32(
+			_mm256_add_epi32(_mm256_add_epi32(x1, x2), _mm256_set1_epi32(BMP180_PARAM_MI)), 4));
+		p = _mm256_andnot_si256(bad, p);
+		_mm256_storeu_si256((__m256i *)&pPressure[i], p);
+	}
+
+	pBatch->b5 = carry;
+	bmp180_batch_compensate_scalar(pBatch, pUt + i, pUp + i, count - i,
+		pTemp != NULL ? pTemp + i : NULL, pPressure != NULL ? pPressure + i : NULL);
+}
+
+#else
+
+int bmp180_batch_have_avx2(void)
+{
+	return 0;
+}
+
+void bmp180_batch_compensate_avx2(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure)
+{
+	bmp180_batch_compensate_scalar(pBatch, pUt, pUp, count, pTemp, pPressure);
+}
+
+#endif
+
+//------------------------------------------------------------------------
+void bmp180_batch_compensate(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure)
+{
+	if (bmp180_batch_have_avx2())
+		bmp180_batch_compensate_avx2(pBatch, pUt, pUp, count, pTemp, pPressure);
+	else
+		bmp180_batch_compensate_scalar(pBatch, pUt, pUp, count, pTemp, pPressure);
+}
+
+struct batch_chunk {
+	pthread_t thread;
+	struct bmp180_batch batch;
+	const uint32_t *pUt;
+	const uint32_t *pUp;
+	size_t count;
+	int16_t *pTemp;
+	int32_t *pPressure;
+};
+
+static void *chunk_main(void *pArg)
+{
+	struct batch_chunk *pChunk = pArg;
+
+	bmp180_batch_compensate(&pChunk->batch, pChunk->pUt, pChunk->pUp, pChunk->count,
+		pChunk->pTemp, pChunk->pPressure);
+	return NULL;
+}
+
+void bmp180_batch_compensate_mt(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure, int threads)
+{
+	struct batch_chunk *pChunks;
+	size_t start, per, k;
+	int t;
+
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if ((size_t)threads > count / MT_MIN_CHUNK)
+		threads = (int)(count / MT_MIN_CHUNK);
+	pChunks = (threads > 1) ? calloc((size_t)threads, sizeof(*pChunks)) : NULL;
+	if (pChunks == NULL)
+	{
+		bmp180_batch_compensate(pBatch, pUt, pUp, count, pTemp, pPressure);
+		return;
+	}
+
+	per = (count + (size_t)threads - 1) / (size_t)threads;
+	for (t = 0; t < threads; t++)
+	{
+		start = (size_t)t * per;
+		pChunks[t].batch = *pBatch;
+		pChunks[t].pUt = pUt + start;
+		pChunks[t].pUp = pUp + start;
+		pChunks[t].count = (start + per <= count) ? per : count - start;
+		pChunks[t].pTemp = (pTemp != NULL) ? pTemp + start : NULL;
+		pChunks[t].pPressure = (pPressure != NULL) ? pPressure + start : NULL;
+
+		// Seed each chunk with the b5 of the last valid temperature before it
+		for (k = start; k > 0; k--)
+			if (scalar_b5(&pBatch->calib, pUt[k - 1], &pChunks[t].batch.b5))
+				break;
+
+		pthread_create(&pChunks[t].thread, NULL, chunk_main, &pChunks[t]);
+	}
+	for (t = 0; t < threads; t++)
+		pthread_join(pChunks[t].thread, NULL);
+
+	pBatch->b5 = pChunks[threads - 1].batch.b5;
+	free(pChunks);
+}
@@ -0,0 +1,49 @@
+/*
+ * bmp180_batch.h
+ *
+ *  Batch BMP180 compensation for reprocessing raw ut/up streams on the host.
+ *
+ *  Each sample is compensated exactly as bmp180_get_temperature() followed
+ *  by bmp180_get_pressure() would on the station, in order, including:
+ *
+ *  - a temperature whose divisor is zero returns BMP180_INVALID_DATA and
+ *    leaves b5 as it was, so the pressure of that sample (and of any that
+ *    follow it before the next valid temperature) uses the carried b5;
+ *  - the b7 < 0x80000000 branch and the b4 divisor check of the pressure.
+ *
+ *  The driver only rejects x1 == 0 && md == 0; any other zero divisor
+ *  (x1 == -md) would trap there. The batch code treats it as invalid too.
+ */
+
+#ifndef BMP180_BATCH_H_
+#define BMP180_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../WeatherStation5000/include/bmp180.h"
+
+struct bmp180_batch {
+	struct bmp180_calib_param_t calib;
+	int16_t oss;				// oversampling setting the up values were taken with
+	int32_t b5;					// in: b5 before the first sample; out: after the last
+};
+
+// Compensates count samples. pTemp (0.1 C) or pPressure (Pa) may be NULL.
+// Uses AVX2 when the CPU has it.
+void bmp180_batch_compensate(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure);
+
+// The same on the given number of threads (0: one per online CPU).
+void bmp180_batch_compensate_mt(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure, int threads);
+
+// Single-path entry points, for testing and benchmarks. The AVX2 one must
+// only be called when bmp180_batch_have_avx2() is true.
+void bmp180_batch_compensate_scalar(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure);
+void bmp180_batch_compensate_avx2(struct bmp180_batch *pBatch, const uint32_t *pUt,
+	const uint32_t *pUp, size_t count, int16_t *pTemp, int32_t *pPressure);
+int  bmp180_batch_have_avx2(void);
+
+#endif /* BMP180_BATCH_H_ */
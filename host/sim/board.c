@@ -0,0 +1,474 @@
+#include <setjmp.h>
+#include <string.h>
+
+#include "mcu_regs.h"
+#include "type.h"
+#include "uart.h"
+#include "timer32.h"
+#include "i2c.h"
+#include "gpio.h"
+#include "ssp.h"
+#include "adc.h"
+#include "rgb.h"
+#include "rotary.h"
+#include "light.h"
+#include "oled.h"
+#include "temp.h"
+#include "joystick.h"
+#include "eeprom.h"
+#include "sim.h"
+#include "../../WeatherStation5000/include/clockmgr.h"
+#include "../../WeatherStation5000/include/input.h"
+#include "../../WeatherStation5000/include/stackmon.h"
+#include "../../WeatherStation5000/include/temperature.h"
+
+#define BMP180_WRITE_ADDR	0xEE
+#define BMP180_READ_ADDR	0xEF
+#define BMP180_CHIP_ID		0x55
+
+// Bus cost of the board library stubs, after the Lib_EaBaseBoard drivers:
+// oled_putPixel() sets page and column (3 commands) and writes the byte
+// holding the pixel; characters are 6x8 pixels drawn one by one;
+// oled_clearScreen() addresses each of the 8 pages and writes a full row.
+#define OLED_PIXEL_BYTES	4
+#define OLED_CHAR_PIXELS	(6 * 8)
+#define OLED_CLEAR_BYTES	((OLED_DISPLAY_HEIGHT / 8) * (3 + OLED_DISPLAY_WIDTH))
+
+// BMP180 maximum conversion times (datasheet, rounded up to the ms) for
+// ut and for up at OSS 0..3
+#define BMP180_UT_MS		5
+#define BMP180_UP_MS(oss)	(2 + (3 << (oss)))
+
+// I2C at 100 kHz, 9 bit times per byte. The virtual clock is not moved
+// by bus traffic (replay drives SysTick itself), so the conversion check
+// adds the bus time on top of it.
+#define I2C_BYTE_US			90
+
+// SSP to the OLED at 2.25 MHz, 8 bit times per byte
+#define SSP_BYTE_NS			3556
+
+// light_read(): two register reads, each an address + command write and
+// an address + data read
+#define LIGHT_READ_TRANSACTIONS	4
+#define LIGHT_READ_BYTES		8
+
+// 24LC08: writes go in 16 byte pages, each its own transaction with the
+// word address; a read is a word address write and one sequential read.
+#define EEPROM_PAGE_SIZE	16
+
+SysTick_Type sim_SysTick;
+LPC_SYSCON_TypeDef sim_SYSCON;
+LPC_IOCON_TypeDef sim_IOCON;
+uint32_t SystemCoreClock = 72000000;
+
+static jmp_buf simExit;
+static int simStatus;
+
+static uint8_t eeprom[EEPROM_TOTAL_SIZE];
+static uint32_t eepromWear[EEPROM_TOTAL_SIZE];
+static struct sim_counters counters;
+
+// BMP180 register file as seen over I2C
+static struct {
+	uint8_t reg;
+	uint8_t ctrl;
+	uint8_t adc[3];
+	uint8_t prom[SIM_BMP180_PROM_SIZE];
+	uint8_t promLoaded;
+	uint64_t readyUs;		// time the running conversion ends, see bus_now_us()
+} bmp180;
+
+//------------------------------------------------------------------------
+int sim_run_firmware(void)
+{
+	if (setjmp(simExit) == 0)
+	{
+		ws_firmware_main();
+		return 0;
+	}
+	return simStatus;
+}
+
+void sim_stop(int status)
+{
+	simStatus = status;
+	longjmp(simExit, 1);
+}
+
+void sim_get_counters(struct sim_counters *pCounters)
+{
+	*pCounters = counters;
+}
+
+// Virtual time plus the I2C bus time spent so far
+static uint64_t bus_now_us(void)
+{
+	return sim_clock_now() * 1000 + (uint64_t)counters.i2cBytes * I2C_BYTE_US;
+}
+
+static void count_i2c(uint32_t transactions, uint32_t bytes)
+{
+	counters.i2cTransactions += transactions;
+	counters.i2cBytes += bytes;
+}
+
+//------------------------------------------------------------------------
+uint32_t SysTick_Config(uint32_t ticks)
+{
+	SysTick->LOAD = ticks - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | 0x3;
+	return 0;
+}
+
+//------------------------------------------------------------------------
+static void bmp180_convert(uint8_t cmd)
+{
+	uint32_t raw;
+	uint8_t oss;
+
+	bmp180.ctrl = cmd;
+	if (cmd == 0x2E)
+	{
+		bmp180.readyUs = bus_now_us() + BMP180_UT_MS * 1000;
+		raw = sim_bmp180_ut();
+		bmp180.adc[0] = (uint8_t)(raw >> 8);
+		bmp180.adc[1] = (uint8_t)raw;
+		bmp180.adc[2] = 0;
+	}
+	else if ((cmd & 0x3F) == 0x34)
+	{
+		oss = cmd >> 6;
+		bmp180.readyUs = bus_now_us() + BMP180_UP_MS(oss) * 1000;
+		raw = sim_bmp180_up(oss) << (8 - oss);
+		bmp180.adc[0] = (uint8_t)(raw >> 16);
+		bmp180.adc[1] = (uint8_t)(raw >> 8);
+		bmp180.adc[2] = (uint8_t)raw;
+	}
+}
+
+static uint8_t bmp180_read_reg(uint8_t reg)
+{
+	if (reg >= 0xAA && reg < 0xAA + SIM_BMP180_PROM_SIZE)
+	{
+		if (!bmp180.promLoaded)
+		{
+			sim_bmp180_prom(bmp180.prom);
+			bmp180.promLoaded = 1;
+		}
+		return bmp180.prom[reg - 0xAA];
+	}
+	if (reg == 0xD0)
+		return BMP180_CHIP_ID;
+	if (reg == 0xF4)
+		return bmp180.ctrl;
+	if (reg >= 0xF6 && reg <= 0xF8)
+	{
+		if (reg == 0xF6 && bus_now_us() < bmp180.readyUs)
+			counters.bmp180EarlyReads++;
+		return bmp180.adc[reg - 0xF6];
+	}
+	return 0;
+}
+
+uint32_t I2CInit(uint32_t I2cMode, uint32_t slaveAddr)
+{
+	memset(&bmp180, 0, sizeof(bmp180));
+	return TRUE;
+}
+
+Status I2CWrite(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+	count_i2c(1, len + 1);
+	if (!sim_i2c_ok() || addr != BMP180_WRITE_ADDR || len == 0)
+		return ERROR;
+
+	bmp180.reg = buf[0];
+	if (len >= 2 && buf[0] == 0xF4)
+		bmp180_convert(buf[1]);
+
+	return SUCCESS;
+}
+
+Status I2CRead(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+	uint32_t i;
+
+	count_i2c(1, len + 1);
+	if (!sim_i2c_ok() || addr != BMP180_READ_ADDR)
+		return ERROR;
+
+	for (i = 0; i < len; i++)
+		buf[i] = bmp180_read_reg((uint8_t)(bmp180.reg + i));
+
+	return SUCCESS;
+}
+
+//------------------------------------------------------------------------
+void delay32Ms(uint8_t timer_num, uint32_t delayInMs)
+{
+	counters.delayMs += delayInMs;
+	sim_delay_ms(delayInMs);
+}
+
+void init_timer32(uint8_t timer_num, uint32_t timerInterval) {}
+void enable_timer32(uint8_t timer_num) {}
+void disable_timer32(uint8_t timer_num) {}
+void reset_timer32(uint8_t timer_num) {}
+
+//------------------------------------------------------------------------
+void UARTInit(uint32_t Baudrate) {}
+
+void UARTSend(uint8_t *BufferPtr, uint32_t Length)
+{
+	counters.uartBytes += Length;
+	sim_uart_tx(BufferPtr, Length);
+}
+
+void UARTSendString(uint8_t *str)
+{
+	UARTSend(str, (uint32_t)strlen((const char *)str));
+}
+
+//------------------------------------------------------------------------
+void GPIOInit(void) {}
+void GPIOSetDir(uint32_t portNum, uint32_t bitPosi, uint32_t dir) {}
+void GPIOSetValue(uint32_t portNum, uint32_t bitPosi, uint32_t bitVal) {}
+
+uint32_t GPIOGetValue(uint32_t portNum, uint32_t bitPosi)
+{
+	return sim_gpio_read(portNum, bitPosi);
+}
+
+//------------------------------------------------------------------------
+void SSPInit(void) {}
+void SSPSend(uint8_t *Buf, uint32_t Length)
+{
+	counters.sspBytes += Length;
+}
+void SSPReceive(uint8_t *buf, uint32_t Length) {}
+
+void ADCInit(uint32_t ADC_Clk) {}
+uint32_t ADCRead(uint8_t channelNum) { return 0; }
+
+void rgb_init(void) {}
+void rgb_setLeds(uint8_t ledMask) {}
+
+//------------------------------------------------------------------------
+void oled_init(void) {}
+
+void oled_putPixel(uint8_t x, uint8_t y, oled_color_t color)
+{
+	counters.sspBytes += OLED_PIXEL_BYTES;
+}
+
+void oled_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, oled_color_t color)
+{
+	uint32_t dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+	uint32_t dy = (y1 > y0) ? y1 - y0 : y0 - y1;
+
+	counters.sspBytes += ((dx > dy ? dx : dy) + 1) * OLED_PIXEL_BYTES;
+}
+
+void oled_fillRect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, oled_color_t color)
+{
+	uint32_t w = (x1 > x0) ? x1 - x0 + 1 : x0 - x1 + 1;
+	uint32_t h = (y1 > y0) ? y1 - y0 + 1 : y0 - y1 + 1;
+
+	counters.sspBytes += w * h * OLED_PIXEL_BYTES;
+}
+
+void oled_clearScreen(oled_color_t color)
+{
+	counters.sspBytes += OLED_CLEAR_BYTES;
+}
+
+uint8_t oled_putString(uint8_t x, uint8_t y, uint8_t *pStr, oled_color_t fb, oled_color_t bg)
+{
+	uint8_t len = (uint8_t)strlen((const char *)pStr);
+
+	counters.sspBytes += (uint32_t)len * OLED_CHAR_PIXELS * OLED_PIXEL_BYTES;
+	return len;
+}
+
+//------------------------------------------------------------------------
+void light_init(void) {}
+void light_enable(void) {}
+void light_setRange(light_range_t newRange) {}
+void light_shutdown(void) {}
+
+uint32_t light_read(void)
+{
+	count_i2c(LIGHT_READ_TRANSACTIONS, LIGHT_READ_BYTES);
+	return sim_light_read();
+}
+
+void temp_init(uint32_t (*getMsTicks)(void)) {}
+
+int32_t temp_read(void)
+{
+	return sim_temp_read();
+}
+
+void joystick_init(void) {}
+
+// The firmware takes its input from input.h; the keys read as released.
+uint8_t joystick_read(void)
+{
+	return 0;
+}
+
+void rotary_init(void) {}
+
+uint8_t rotary_read(void)
+{
+	return ROTARY_WAIT;
+}
+
+//------------------------------------------------------------------------
+// WeatherStation5000/src/input.c and temperature.c need the GPIO interrupts
+static uint32_t (*pInputTicks)(void) = NULL;
+
+void input_init(uint32_t (*getMsTicks)(void))
+{
+	pInputTicks = getMsTicks;
+}
+
+// Simulated keys arrive settled
+void input_tick(void) {}
+
+static uint32_t inputEventMs = 0;
+
+uint8_t input_get(void)
+{
+	// When the input about to be returned was queued
+	uint32_t ms = pInputTicks() - sim_input_age_ms();
+	uint8_t event = sim_input_get();
+
+	if (event != INPUT_NONE)
+		inputEventMs = ms;
+	return event;
+}
+
+// Simulated input arrives once per pass of the main loop, via input_get()
+uint8_t input_pending(void)
+{
+	return 0;
+}
+
+void input_wait(uint32_t ms)
+{
+	counters.waitMs += ms;
+	sim_input_wait(ms);
+}
+
+__attribute__((weak)) void sim_input_wait(uint32_t ms)
+{
+	sim_delay_ms(ms);
+}
+
+uint32_t input_event_ms(void)
+{
+	return inputEventMs;
+}
+
+__attribute__((weak)) uint32_t sim_input_age_ms(void)
+{
+	return 0;
+}
+
+__attribute__((weak)) uint8_t sim_i2c_ok(void)
+{
+	return 1;
+}
+
+uint32_t input_overflows(void)
+{
+	return 0;
+}
+
+void temperature_init(void) {}
+
+uint8_t temperature_ready(void)
+{
+	return 1;
+}
+
+int32_t temperature_read(void)
+{
+	return sim_temp_read();
+}
+
+uint32_t temperature_count(void)
+{
+	return 0;
+}
+
+// The virtual clock does not scale with the core clock: a switch only
+// changes what clock_ms() accounts to
+void clock_hw_set(uint8_t mode, uint32_t hz, uint32_t uartBaud) {}
+
+// Drawing takes no virtual time, so the time within the millisecond is
+// the SSP traffic so far; clock_us() differences across an OLED update
+// then give its transfer time.
+uint32_t clock_hw_us(void)
+{
+	return (uint32_t)((uint64_t)counters.sspBytes * SSP_BYTE_NS / 1000);
+}
+
+// The host stack is not painted; a peak of 0 sends no memory frames
+void stackmon_paint(void) {}
+
+uint32_t stackmon_size(void)
+{
+	return 0;
+}
+
+uint32_t stackmon_peak(void)
+{
+	return 0;
+}
+
+uint32_t stackmon_static(void)
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------
+int16_t eeprom_read(uint8_t* buf, uint16_t offset, uint16_t len)
+{
+	if (offset >= EEPROM_TOTAL_SIZE)
+		return 0;
+	if (len > EEPROM_TOTAL_SIZE - offset)
+		len = EEPROM_TOTAL_SIZE - offset;
+	count_i2c(2, 2 + 1 + len);
+	memcpy(buf, &eeprom[offset], len);
+	return (int16_t)len;
+}
+
+int16_t eeprom_write(uint8_t* buf, uint16_t offset, uint16_t len)
+{
+	uint32_t pages, i;
+
+	if (offset >= EEPROM_TOTAL_SIZE)
+		return 0;
+	if (len > EEPROM_TOTAL_SIZE - offset)
+		len = EEPROM_TOTAL_SIZE - offset;
+	pages = (offset + len + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE - offset / EEPROM_PAGE_SIZE;
+	count_i2c(pages, pages * 2 + len);
+	counters.eepromWrites++;
+	for (i = 0; i < len; i++)
+		eepromWear[offset + i]++;
+	memcpy(&eeprom[offset], buf, len);
+	return (int16_t)len;
+}
+
+uint32_t sim_eeprom_max_wear(void)
+{
+	uint32_t i, max = 0;
+
+	for (i = 0; i < EEPROM_TOTAL_SIZE; i++)
+		if (eepromWear[i] > max)
+			max = eepromWear[i];
+	return max;
+}
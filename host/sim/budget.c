@@ -0,0 +1,425 @@
+/*
+ * budget.c
+ *
+ *  Runs the firmware through a scripted scenario and checks the work each
+ *  pass of the main loop puts on the board (I2C, blocking delays, OLED
+ *  SSP traffic, EEPROM writes, UART) against a stored baseline:
+ *
+ *      ws_budget [-w] [-t percent] [-c capture] scenario baseline
+ *
+ *  A scenario is a text file of
+ *
+ *      iterations <n>              passes of the main loop to run
+ *      <pass> <event> [count]      input queued before that pass
+ *
+ *  with events named as in input.h (RIGHT, ROTARY_LEFT, ...); '#' starts
+ *  a comment. Sensor readings are synthetic and deterministic, so a run
+ *  gives the same counts every time.
+ *
+ *  Boot (reset to the first pass) is budgeted on its own; for the passes
+ *  the baseline holds the worst pass and the total. A count above the
+ *  baseline by more than the tolerance (default 0%) fails the run. -w
+ *  writes the measured counts as the new baseline instead.
+ *
+ *  UART bytes exclude the record frames of the RECORD_ENABLE build the
+ *  simulation runs, which the field firmware does not send. -c saves the
+ *  whole UART stream from reset as a capture for ws_replay.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "../../WeatherStation5000/include/frame.h"
+#include "../../WeatherStation5000/include/input.h"
+#include "../../WeatherStation5000/include/record.h"
+
+#define MAX_EVENTS		256
+#define COUNTERS		7
+
+struct event {
+	uint32_t pass;
+	uint8_t input;
+};
+
+struct budget {
+	uint32_t boot;
+	uint32_t worst;
+	uint32_t total;
+};
+
+static const char *counterNames[COUNTERS] = {
+	"i2c_transactions", "i2c_bytes", "delay_ms", "wait_ms",
+	"ssp_bytes", "eeprom_writes", "uart_bytes"
+};
+
+// wait_ms follows the delay the scenario dials in; reported, not budgeted
+static const uint8_t budgeted[COUNTERS] = { 1, 1, 1, 0, 1, 1, 1 };
+
+static const char *inputNames[] = {
+	"NONE", "LEFT", "RIGHT", "UP", "DOWN", "CENTER", "BUTTON",
+	"ROTARY_RIGHT", "ROTARY_LEFT"
+};
+
+static struct event events[MAX_EVENTS];
+static uint32_t eventCount = 0;
+static uint32_t nextEvent = 0;
+static uint32_t iterations = 0;
+
+static uint32_t pass = 0;				// passes started
+static uint8_t passOpen = 0;			// inside the input drain of a pass
+static struct sim_counters mark;
+static uint32_t recordBytes = 0, recordMark = 0;
+static struct budget measured[COUNTERS];
+
+static struct frame_decoder txDecoder;
+static FILE *pCapture = NULL;
+static uint32_t rngState = 2463534242u;
+
+//------------------------------------------------------------------------
+static int parse_scenario(const char *pPath)
+{
+	FILE *pFile = fopen(pPath, "r");
+	char line[128], name[32];
+	unsigned at, count, i;
+	int fields;
+	uint8_t input;
+
+	if (pFile == NULL)
+	{
+		perror(pPath);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		char *pHash = strchr(line, '#');
+
+		if (pHash != NULL)
+			*pHash = '\0';
+		if (sscanf(line, " iterations %u", &at) == 1)
+		{
+			iterations = at;
+			continue;
+		}
+		fields = sscanf(line, " %u %31s %u", &at, name, &count);
+		if (fields <= 0)
+			continue;
+		if (fields < 2)
+			goto bad;
+		if (fields == 2)
+			count = 1;
+
+		for (input = INPUT_LEFT; input <= INPUT_ROTARY_LEFT; input++)
+			if (strcmp(name, inputNames[input]) == 0)
+				break;
+		if (input > INPUT_ROTARY_LEFT || (eventCount > 0 && at < events[eventCount - 1].pass))
+			goto bad;
+
+		for (i = 0; i < count; i++)
+		{
+			if (eventCount == MAX_EVENTS)
+				goto bad;
+			events[eventCount].pass = at;
+			events[eventCount].input = input;
+			eventCount++;
+		}
+	}
+
+	fclose(pFile);
+	if (iterations == 0)
+	{
+		fprintf(stderr, "ws_budget: %s sets no iterations\n", pPath);
+		return -1;
+	}
+	return 0;
+
+bad:
+	fprintf(stderr, "ws_budget: %s: bad line: %s", pPath, line);
+	fclose(pFile);
+	return -1;
+}
+
+static int read_baseline(const char *pPath, struct budget *pBase)
+{
+	FILE *pFile = fopen(pPath, "r");
+	char line[128], name[32];
+	struct budget b;
+	int found = 0, i;
+
+	if (pFile == NULL)
+	{
+		perror(pPath);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		if (line[0] == '#' || sscanf(line, "%31s %u %u %u", name, &b.boot, &b.worst, &b.total) != 4)
+			continue;
+		for (i = 0; i < COUNTERS; i++)
+		{
+			if (strcmp(name, counterNames[i]) == 0)
+			{
+				pBase[i] = b;
+				found |= 1 << i;
+			}
+		}
+	}
+
+	fclose(pFile);
+	for (i = 0; i < COUNTERS; i++)
+	{
+		if (budgeted[i] && !(found & (1 << i)))
+		{
+			fprintf(stderr, "ws_budget: %s has no %s budget\n", pPath, counterNames[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int write_baseline(const char *pPath, const char *pScenario)
+{
+	FILE *pFile = fopen(pPath, "w");
+	int i;
+
+	if (pFile == NULL)
+	{
+		perror(pPath);
+		return -1;
+	}
+
+	fprintf(pFile, "# ws_budget baseline for %s, %u passes\n", pScenario, iterations);
+	fprintf(pFile, "# counter boot worst_pass total\n");
+	for (i = 0; i < COUNTERS; i++)
+		if (budgeted[i])
+			fprintf(pFile, "%s %u %u %u\n", counterNames[i],
+				measured[i].boot, measured[i].worst, measured[i].total);
+	fclose(pFile);
+	return 0;
+}
+
+//------------------------------------------------------------------------
+static void counters_to_array(const struct sim_counters *pC, uint32_t recBytes, uint32_t *pOut)
+{
+	pOut[0] = pC->i2cTransactions;
+	pOut[1] = pC->i2cBytes;
+	pOut[2] = pC->delayMs;
+	pOut[3] = pC->waitMs;
+	pOut[4] = pC->sspBytes;
+	pOut[5] = pC->eepromWrites;
+	pOut[6] = pC->uartBytes - recBytes;
+}
+
+// Closes boot (pass 0) or the pass before, at the start of the next one
+static void close_pass(void)
+{
+	struct sim_counters now;
+	uint32_t before[COUNTERS], after[COUNTERS], delta;
+	int i;
+
+	sim_get_counters(&now);
+	counters_to_array(&mark, recordMark, before);
+	counters_to_array(&now, recordBytes, after);
+	for (i = 0; i < COUNTERS; i++)
+	{
+		delta = after[i] - before[i];
+		if (pass == 0)
+		{
+			measured[i].boot = delta;
+			continue;
+		}
+		measured[i].total += delta;
+		if (delta > measured[i].worst)
+			measured[i].worst = delta;
+	}
+	mark = now;
+	recordMark = recordBytes;
+}
+
+//------------------------------------------------------------------------
+static uint32_t rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+void sim_bmp180_prom(uint8_t *pProm)
+{
+	// Bosch datasheet example calibration
+	static const uint8_t prom[SIM_BMP180_PROM_SIZE] = {
+		0x01, 0x98, 0xFF, 0xB8, 0xC7, 0xD1, 0x7F, 0xE5, 0x7F, 0xF5, 0x5A,
+		0x71, 0x18, 0x2E, 0x00, 0x04, 0x80, 0x00, 0xDD, 0xF9, 0x0B, 0x34
+	};
+
+	memcpy(pProm, prom, sizeof(prom));
+}
+
+uint16_t sim_bmp180_ut(void)
+{
+	return 27898 + rng() % 8;
+}
+
+uint32_t sim_bmp180_up(uint8_t oss)
+{
+	return (23843 + rng() % 16) << oss;
+}
+
+int32_t sim_temp_read(void)
+{
+	return 215 + rng() % 5;
+}
+
+uint32_t sim_light_read(void)
+{
+	return 300 + rng() % 100;
+}
+
+uint8_t sim_input_get(void)
+{
+	if (!passOpen)
+	{
+		close_pass();
+		if (pass == iterations)
+			sim_stop(0);
+		pass++;
+		passOpen = 1;
+	}
+
+	if (nextEvent < eventCount && events[nextEvent].pass <= pass)
+		return events[nextEvent++].input;
+
+	passOpen = 0;
+	return INPUT_NONE;
+}
+
+uint32_t sim_gpio_read(uint32_t port, uint32_t bit)
+{
+	return 1;
+}
+
+void sim_delay_ms(uint32_t ms)
+{
+	sim_clock_run(ms, NULL);
+}
+
+void sim_uart_tx(const uint8_t *pData, uint32_t len)
+{
+	uint32_t i;
+
+	if (pCapture != NULL && fwrite(pData, 1, len, pCapture) != len)
+	{
+		perror("capture");
+		sim_stop(2);
+	}
+	for (i = 0; i < len; i++)
+	{
+		if (frame_decoder_feed(&txDecoder, pData[i]) != FRAME_READY)
+			continue;
+		if (txDecoder.type >= REC_CALIB && txDecoder.type <= REC_TICK)
+			recordBytes += FRAME_HEADER_SIZE + txDecoder.len + 1;
+	}
+}
+
+//------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	struct budget base[COUNTERS];
+	double tolerance = 0;
+	const char *pCaptureName = NULL;
+	int write = 0, failed = 0, opt, i;
+	uint32_t limit;
+
+	while ((opt = getopt(argc, argv, "wt:c:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w':
+			write = 1;
+			break;
+		case 't':
+			tolerance = atof(optarg) / 100;
+			break;
+		case 'c':
+			pCaptureName = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind != 2)
+		goto usage;
+
+	if (parse_scenario(argv[optind]) != 0)
+		return 2;
+	if (!write && read_baseline(argv[optind + 1], base) != 0)
+		return 2;
+
+	if (pCaptureName != NULL && (pCapture = fopen(pCaptureName, "wb")) == NULL)
+	{
+		perror(pCaptureName);
+		return 2;
+	}
+
+	frame_decoder_init(&txDecoder);
+	if (sim_run_firmware() != 0 || pass < iterations)
+	{
+		fprintf(stderr, "ws_budget: firmware stopped after %u of %u passes\n", pass, iterations);
+		return 2;
+	}
+	if (pCapture != NULL && fclose(pCapture) != 0)
+	{
+		perror(pCaptureName);
+		return 2;
+	}
+
+	if (write)
+	{
+		if (write_baseline(argv[optind + 1], argv[optind]) != 0)
+			return 2;
+		printf("wrote %s\n", argv[optind + 1]);
+	}
+
+	printf("%s: %u passes, %llu ms\n", argv[optind], iterations,
+		(unsigned long long)sim_clock_now());
+	printf("%-18s %10s %10s %12s\n", "counter", "boot", "worst", "total");
+	for (i = 0; i < COUNTERS; i++)
+	{
+		const char *pVerdict = "";
+
+		if (!write && budgeted[i])
+		{
+			limit = base[i].boot + (uint32_t)(base[i].boot * tolerance);
+			if (measured[i].boot > limit)
+				pVerdict = "  OVER (boot)";
+			limit = base[i].worst + (uint32_t)(base[i].worst * tolerance);
+			if (measured[i].worst > limit)
+				pVerdict = "  OVER (worst pass)";
+			limit = base[i].total + (uint32_t)(base[i].total * tolerance);
+			if (measured[i].total > limit)
+				pVerdict = "  OVER (total)";
+			if (pVerdict[0] != '\0')
+			{
+				printf("%-18s %10u %10u %12u%s, budget %u %u %u\n", counterNames[i],
+					measured[i].boot, measured[i].worst, measured[i].total, pVerdict,
+					base[i].boot, base[i].worst, base[i].total);
+				failed = 1;
+				continue;
+			}
+		}
+		printf("%-18s %10u %10u %12u\n", counterNames[i],
+			measured[i].boot, measured[i].worst, measured[i].total);
+	}
+	if (!write)
+		printf("%s\n", failed ? "FAIL: over budget" : "PASS");
+	return failed;
+
+usage:
+	fprintf(stderr, "usage: %s [-w] [-t percent] [-c capture] scenario baseline\n", argv[0]);
+	return 2;
+}
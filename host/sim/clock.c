@@ -0,0 +1,115 @@
+/*
+ * clock.c
+ *
+ *  Virtual time for the simulation. Pending events sit in a binary
+ *  min-heap on their due time; sim_clock_run() moves straight from one to
+ *  the next, so the only per-ms cost left is the firmware's SysTick.
+ */
+
+#include <stddef.h>
+
+#include "sim.h"
+
+struct event {
+	uint64_t atMs;
+	uint32_t order;			// keeps events due at the same ms in FIFO order
+	sim_event_fn fn;
+	void *pCtx;
+};
+
+static struct event heap[SIM_CLOCK_EVENTS];
+static uint32_t heapCount = 0;
+static uint32_t nextOrder = 0;
+static uint64_t nowMs = 0;
+
+static int before(const struct event *pA, const struct event *pB)
+{
+	return pA->atMs < pB->atMs || (pA->atMs == pB->atMs && pA->order < pB->order);
+}
+
+static void swap(uint32_t a, uint32_t b)
+{
+	struct event tmp = heap[a];
+
+	heap[a] = heap[b];
+	heap[b] = tmp;
+}
+
+static void pop(struct event *pOut)
+{
+	uint32_t i = 0, child;
+
+	*pOut = heap[0];
+	heap[0] = heap[--heapCount];
+	for (;;)
+	{
+		child = 2 * i + 1;
+		if (child >= heapCount)
+			break;
+		if (child + 1 < heapCount && before(&heap[child + 1], &heap[child]))
+			child++;
+		if (!before(&heap[child], &heap[i]))
+			break;
+		swap(i, child);
+		i = child;
+	}
+}
+
+static void advance_to(uint64_t atMs)
+{
+	while (nowMs < atMs)
+	{
+		SysTick_Handler();
+		nowMs++;
+	}
+}
+
+void sim_clock_reset(void)
+{
+	heapCount = 0;
+	nextOrder = 0;
+	nowMs = 0;
+}
+
+uint64_t sim_clock_now(void)
+{
+	return nowMs;
+}
+
+int sim_clock_at(uint64_t atMs, sim_event_fn fn, void *pCtx)
+{
+	uint32_t i;
+
+	if (heapCount == SIM_CLOCK_EVENTS)
+		return -1;
+
+	i = heapCount++;
+	heap[i].atMs = (atMs < nowMs) ? nowMs : atMs;
+	heap[i].order = nextOrder++;
+	heap[i].fn = fn;
+	heap[i].pCtx = pCtx;
+	while (i > 0 && before(&heap[i], &heap[(i - 1) / 2]))
+	{
+		swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	return 0;
+}
+
+uint32_t sim_clock_run(uint32_t ms, uint8_t (*pWake)(void))
+{
+	uint64_t start = nowMs;
+	uint64_t end = nowMs + ms;
+	struct event ev;
+
+	while (heapCount > 0 && heap[0].atMs <= end)
+	{
+		pop(&ev);
+		advance_to(ev.atMs);
+		ev.fn(ev.pCtx);
+		if (pWake != NULL && pWake())
+			return (uint32_t)(nowMs - start);
+	}
+	advance_to(end);
+	return ms;
+}
@@ -0,0 +1,14 @@
+/*
+ * adc.h - host simulation stand-in for the Lib_MCU ADC driver.
+ */
+#ifndef __ADC_H
+#define __ADC_H
+
+#include "type.h"
+
+#define ADC_CLK		4500000
+
+void ADCInit(uint32_t ADC_Clk);
+uint32_t ADCRead(uint8_t channelNum);
+
+#endif /* __ADC_H */
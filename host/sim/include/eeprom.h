@@ -0,0 +1,14 @@
+/*
+ * eeprom.h - host simulation stand-in for the EaBaseBoard 24LC08 driver.
+ */
+#ifndef __EEPROM_H
+#define __EEPROM_H
+
+#include "type.h"
+
+#define EEPROM_TOTAL_SIZE	1024
+
+int16_t eeprom_read(uint8_t* buf, uint16_t offset, uint16_t len);
+int16_t eeprom_write(uint8_t* buf, uint16_t offset, uint16_t len);
+
+#endif /* __EEPROM_H */
@@ -0,0 +1,19 @@
+/*
+ * gpio.h - host simulation stand-in for the Lib_MCU GPIO driver.
+ */
+#ifndef __GPIO_H
+#define __GPIO_H
+
+#include "type.h"
+
+#define PORT0	0
+#define PORT1	1
+#define PORT2	2
+#define PORT3	3
+
+void GPIOInit(void);
+void GPIOSetDir(uint32_t portNum, uint32_t bitPosi, uint32_t dir);
+uint32_t GPIOGetValue(uint32_t portNum, uint32_t bitPosi);
+void GPIOSetValue(uint32_t portNum, uint32_t bitPosi, uint32_t bitVal);
+
+#endif /* __GPIO_H */
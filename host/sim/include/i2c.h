@@ -0,0 +1,18 @@
+/*
+ * i2c.h - host simulation stand-in for the Lib_MCU I2C master driver.
+ *
+ * Transfers are routed to the device models in host/sim/board.c.
+ */
+#ifndef __I2C_H
+#define __I2C_H
+
+#include "type.h"
+
+#define I2CMASTER	0x01
+#define I2CSLAVE	0x02
+
+uint32_t I2CInit(uint32_t I2cMode, uint32_t slaveAddr);
+Status I2CRead(uint32_t addr, uint8_t* buf, uint32_t len);
+Status I2CWrite(uint32_t addr, uint8_t* buf, uint32_t len);
+
+#endif /* __I2C_H */
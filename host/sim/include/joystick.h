@@ -0,0 +1,18 @@
+/*
+ * joystick.h - host simulation stand-in for the EaBaseBoard joystick driver.
+ */
+#ifndef __JOYSTICK_H
+#define __JOYSTICK_H
+
+#include "type.h"
+
+#define JOYSTICK_CENTER	0x01
+#define JOYSTICK_UP		0x02
+#define JOYSTICK_DOWN	0x04
+#define JOYSTICK_LEFT	0x08
+#define JOYSTICK_RIGHT	0x10
+
+void joystick_init(void);
+uint8_t joystick_read(void);
+
+#endif /* __JOYSTICK_H */
@@ -0,0 +1,23 @@
+/*
+ * light.h - host simulation stand-in for the EaBaseBoard ISL29003 driver.
+ */
+#ifndef __LIGHT_H
+#define __LIGHT_H
+
+#include "type.h"
+
+typedef enum
+{
+	LIGHT_RANGE_1000 = 0,
+	LIGHT_RANGE_4000,
+	LIGHT_RANGE_16000,
+	LIGHT_RANGE_64000
+} light_range_t;
+
+void light_init(void);
+void light_enable(void);
+uint32_t light_read(void);
+void light_setRange(light_range_t newRange);
+void light_shutdown(void);
+
+#endif /* __LIGHT_H */
@@ -0,0 +1,44 @@
+/*
+ * mcu_regs.h - host simulation stand-in for the LPC13xx register header.
+ *
+ * Only the registers the firmware touches are modelled; they are plain
+ * memory owned by host/sim/board.c.
+ */
+#ifndef __MCU_REGS_H__
+#define __MCU_REGS_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_CLKSOURCE_Msk	(1UL << 2)
+
+typedef struct
+{
+	volatile uint32_t SYSTICKCLKDIV;
+} LPC_SYSCON_TypeDef;
+
+typedef struct
+{
+	volatile uint32_t PIO0_1;
+} LPC_IOCON_TypeDef;
+
+extern SysTick_Type sim_SysTick;
+extern LPC_SYSCON_TypeDef sim_SYSCON;
+extern LPC_IOCON_TypeDef sim_IOCON;
+
+#define SysTick		(&sim_SysTick)
+#define LPC_SYSCON	(&sim_SYSCON)
+#define LPC_IOCON	(&sim_IOCON)
+
+extern uint32_t SystemCoreClock;
+
+uint32_t SysTick_Config(uint32_t ticks);
+
+#endif /* __MCU_REGS_H__ */
@@ -0,0 +1,16 @@
+/*
+ * rgb.h - host simulation stand-in for the EaBaseBoard RGB LED driver.
+ */
+#ifndef __RGB_H
+#define __RGB_H
+
+#include "type.h"
+
+#define RGB_RED		0x01
+#define RGB_BLUE	0x02
+#define RGB_GREEN	0x04
+
+void rgb_init(void);
+void rgb_setLeds(uint8_t ledMask);
+
+#endif /* __RGB_H */
@@ -0,0 +1,13 @@
+/*
+ * ssp.h - host simulation stand-in for the Lib_MCU SSP driver.
+ */
+#ifndef __SSP_H__
+#define __SSP_H__
+
+#include "type.h"
+
+void SSPInit(void);
+void SSPSend(uint8_t *Buf, uint32_t Length);
+void SSPReceive(uint8_t *buf, uint32_t Length);
+
+#endif /* __SSP_H__ */
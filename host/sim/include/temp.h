@@ -0,0 +1,12 @@
+/*
+ * temp.h - host simulation stand-in for the EaBaseBoard MAX6576 driver.
+ */
+#ifndef __TEMP_H
+#define __TEMP_H
+
+#include "type.h"
+
+void temp_init(uint32_t (*getMsTicks)(void));
+int32_t temp_read(void);
+
+#endif /* __TEMP_H */
@@ -0,0 +1,15 @@
+/*
+ * timer32.h - host simulation stand-in for the Lib_MCU 32-bit timer driver.
+ */
+#ifndef __TIMER32_H
+#define __TIMER32_H
+
+#include "type.h"
+
+void delay32Ms(uint8_t timer_num, uint32_t delayInMs);
+void init_timer32(uint8_t timer_num, uint32_t timerInterval);
+void enable_timer32(uint8_t timer_num);
+void disable_timer32(uint8_t timer_num);
+void reset_timer32(uint8_t timer_num);
+
+#endif /* __TIMER32_H */
@@ -0,0 +1,20 @@
+/*
+ * type.h - host simulation stand-in for the Lib_MCU header of the same name.
+ */
+#ifndef __TYPE_H__
+#define __TYPE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef FALSE
+#define FALSE	(0)
+#endif
+
+#ifndef TRUE
+#define TRUE	(1)
+#endif
+
+typedef enum {ERROR = 0, SUCCESS = !ERROR} Status;
+
+#endif /* __TYPE_H__ */
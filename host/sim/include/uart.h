@@ -0,0 +1,13 @@
+/*
+ * uart.h - host simulation stand-in for the Lib_MCU UART driver.
+ */
+#ifndef __UART_H
+#define __UART_H
+
+#include "type.h"
+
+void UARTInit(uint32_t Baudrate);
+void UARTSend(uint8_t *BufferPtr, uint32_t Length);
+void UARTSendString(uint8_t *str);
+
+#endif /* __UART_H */
@@ -0,0 +1,264 @@
+/*
+ * replay.c
+ *
+ *  Replays a raw sensor capture (see WeatherStation5000/include/record.h)
+ *  through the firmware sources as fast as the host allows, and checks that
+ *  every frame the firmware emits on the way matches the capture bit for bit.
+ *
+ *  The capture is the raw UART stream of a RECORD_ENABLE build, taken from
+ *  reset:
+ *
+ *      ws_replay capture.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "../../WeatherStation5000/include/frame.h"
+#include "../../WeatherStation5000/include/i2csched.h"
+#include "../../WeatherStation5000/include/samples.h"
+#include "../../WeatherStation5000/include/record.h"
+
+struct rec {
+	uint8_t type;
+	uint8_t len;
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+static struct rec *pRecs = NULL;
+static uint32_t recCount = 0;
+
+static uint32_t inCursor[REC_BUS + 1];	// next unread record per input type
+static uint32_t outCursor = 0;				// next frame the firmware must emit
+static uint32_t tickCount = 0;
+static uint32_t msTicks = 0;
+static uint8_t inputExhausted = 0;
+
+static struct frame_decoder txDecoder;
+
+//------------------------------------------------------------------------
+static int load_capture(const char *pPath)
+{
+	FILE *pFile = fopen(pPath, "rb");
+	struct frame_decoder dec;
+	uint32_t capacity = 0;
+	int c;
+
+	if (pFile == NULL)
+	{
+		perror(pPath);
+		return -1;
+	}
+
+	frame_decoder_init(&dec);
+	while ((c = fgetc(pFile)) != EOF)
+	{
+		if (frame_decoder_feed(&dec, (uint8_t)c) != FRAME_READY)
+			continue;
+		if (dec.type < REC_CALIB || dec.type > REC_TICK || dec.len < REC_TS_SIZE)
+			continue;
+
+		if (recCount == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 4096;
+			pRecs = realloc(pRecs, capacity * sizeof(*pRecs));
+			if (pRecs == NULL)
+			{
+				fclose(pFile);
+				return -1;
+			}
+		}
+		pRecs[recCount].type = dec.type;
+		pRecs[recCount].len = dec.len;
+		memcpy(pRecs[recCount].payload, dec.payload, dec.len);
+		recCount++;
+	}
+
+	fclose(pFile);
+	return 0;
+}
+
+// Moves the firmware's tick counter up to the timestamp of the next
+// frame it is expected to emit.
+static void advance_clock(void)
+{
+	uint32_t ts;
+
+	if (outCursor >= recCount)
+		return;
+
+	ts = frame_get_u32(pRecs[outCursor].payload);
+	while ((int32_t)(ts - msTicks) > 0)
+	{
+		SysTick_Handler();
+		msTicks++;
+	}
+}
+
+static const uint8_t *next_input(uint8_t type)
+{
+	uint32_t i;
+
+	for (i = inCursor[type]; i < recCount; i++)
+	{
+		if (pRecs[i].type == type)
+		{
+			inCursor[type] = i + 1;
+			return &pRecs[i].payload[REC_TS_SIZE];
+		}
+	}
+
+	// The capture ends inside this iteration; nothing left to verify.
+	inputExhausted = 1;
+	sim_stop(0);
+	return NULL;
+}
+
+static void print_frame(const char *pWhat, uint8_t type, uint8_t len, const uint8_t *pPayload)
+{
+	uint8_t i;
+
+	fprintf(stderr, "  %-8s type 0x%02x len %2u:", pWhat, type, len);
+	for (i = 0; i < len; i++)
+		fprintf(stderr, " %02x", pPayload[i]);
+	fprintf(stderr, "\n");
+}
+
+//------------------------------------------------------------------------
+void sim_uart_tx(const uint8_t *pData, uint32_t len)
+{
+	const struct rec *pExpected;
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (frame_decoder_feed(&txDecoder, pData[i]) != FRAME_READY)
+			continue;
+		if (txDecoder.type < REC_CALIB || txDecoder.type > REC_TICK)
+			continue;
+
+		if (outCursor >= recCount)
+		{
+			sim_stop(0);
+			return;
+		}
+
+		pExpected = &pRecs[outCursor];
+		if (pExpected->type != txDecoder.type || pExpected->len != txDecoder.len
+			|| memcmp(pExpected->payload, txDecoder.payload, txDecoder.len) != 0)
+		{
+			fprintf(stderr, "ws_replay: divergence at frame %u\n", outCursor);
+			print_frame("expected", pExpected->type, pExpected->len, pExpected->payload);
+			print_frame("got", txDecoder.type, txDecoder.len, txDecoder.payload);
+			sim_stop(1);
+			return;
+		}
+
+		if (txDecoder.type == REC_TICK)
+			tickCount++;
+		outCursor++;
+		if (outCursor == recCount)
+		{
+			sim_stop(0);
+			return;
+		}
+		advance_clock();
+	}
+}
+
+void sim_bmp180_prom(uint8_t *pProm)
+{
+	memcpy(pProm, next_input(REC_CALIB), SIM_BMP180_PROM_SIZE);
+}
+
+uint16_t sim_bmp180_ut(void)
+{
+	return frame_get_u16(next_input(REC_UT));
+}
+
+uint32_t sim_bmp180_up(uint8_t oss)
+{
+	return frame_get_u32(next_input(REC_UP));
+}
+
+int32_t sim_temp_read(void)
+{
+	return (int32_t)frame_get_u32(next_input(REC_TEMP));
+}
+
+uint32_t sim_light_read(void)
+{
+	return frame_get_u32(next_input(REC_LIGHT));
+}
+
+uint8_t sim_input_get(void)
+{
+	return *next_input(REC_INPUT);
+}
+
+uint8_t sim_i2c_ok(void)
+{
+	return *next_input(REC_BUS);
+}
+
+uint32_t sim_gpio_read(uint32_t port, uint32_t bit)
+{
+	return 1;
+}
+
+void sim_delay_ms(uint32_t ms)
+{
+	// Replay runs flat out; the capture's timestamps drive msTicks instead.
+}
+
+//------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	struct timespec t0, t1;
+	struct i2csched_stats bus;
+	double seconds;
+	int status;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s <capture>\n", argv[0]);
+		return 2;
+	}
+
+	if (load_capture(argv[1]) != 0)
+		return 2;
+	if (recCount == 0)
+	{
+		fprintf(stderr, "ws_replay: no records in %s\n", argv[1]);
+		return 2;
+	}
+
+	frame_decoder_init(&txDecoder);
+	advance_clock();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	status = sim_run_firmware();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+	printf("%s: %u/%u frames verified%s\n", status == 0 ? "PASS" : "FAIL",
+		outCursor, recCount, inputExhausted ? " (capture ends mid-iteration)" : "");
+	printf("%u samples in %.3f s, %.0f samples/s\n", tickCount, seconds,
+		seconds > 0.0 ? (double)tickCount / seconds : 0.0);
+
+	i2csched_get_stats(&bus);
+	if (bus.runs > 0)
+		printf("i2c: %u bus passes, %.2f ms each (%.2f ms one device at a time), bus %u%% busy\n",
+			bus.runs, bus.elapsedUs / 1000.0 / bus.runs, bus.serialUs / 1000.0 / bus.runs,
+			i2csched_utilisation());
+	printf("sensor reads/requests: temp %u/%u, light %u/%u, pressure %u/%u\n",
+		samples_reads(SAMPLE_TEMP), samples_requests(SAMPLE_TEMP),
+		samples_reads(SAMPLE_LIGHT), samples_requests(SAMPLE_LIGHT),
+		samples_reads(SAMPLE_PRESSURE), samples_requests(SAMPLE_PRESSURE));
+
+	free(pRecs);
+	return status;
+}
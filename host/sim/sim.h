@@ -0,0 +1,96 @@
+/*
+ * sim.h
+ *
+ *  Host simulation of the WeatherStation5000 board.
+ *
+ *  board.c implements the Lib_MCU / Lib_EaBaseBoard entry points the
+ *  firmware links against, stands in for the firmware's interrupt-driven
+ *  drivers (input.c) and models the BMP180 on the I2C bus. Whatever
+ *  the board would sense comes from the hooks below, which are implemented
+ *  by the harness linked next to it (replay.c, ...).
+ *
+ *  The firmware's own sources are compiled unchanged with
+ *  -Dmain=ws_firmware_main and run by sim_run_firmware() until the harness
+ *  calls sim_stop().
+ *
+ *  Time is virtual (clock.c): it only passes when the firmware waits, and
+ *  then jumps from one pending event to the next, so a harness can run
+ *  days of station time in seconds.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+
+#define SIM_BMP180_PROM_SIZE	22
+
+// Harness hooks
+void     sim_bmp180_prom(uint8_t *pProm);
+uint16_t sim_bmp180_ut(void);
+uint32_t sim_bmp180_up(uint8_t oss);
+int32_t  sim_temp_read(void);
+uint32_t sim_light_read(void);
+uint8_t  sim_input_get(void);
+uint32_t sim_gpio_read(uint32_t port, uint32_t bit);
+void     sim_delay_ms(uint32_t ms);
+// input_wait(); defaults to sim_delay_ms(), a harness that queues input
+// at given times overrides it to wake up early.
+void     sim_input_wait(uint32_t ms);
+// Age in ms of the input sim_input_get() returns next, for
+// input_event_ms(); defaults to 0, as if it arrived when the pass picked
+// it up.
+uint32_t sim_input_age_ms(void);
+// Whether the next I2C transfer succeeds; defaults to 1, a harness
+// overrides it to fail transfers on purpose.
+uint8_t  sim_i2c_ok(void);
+void     sim_uart_tx(const uint8_t *pData, uint32_t len);
+
+// Work the firmware put on the board's buses and timers since reset.
+// board.c counts the simulated drivers directly; for the board library
+// stubs it adds what the real drivers put on the wire (see board.c).
+struct sim_counters {
+	uint32_t i2cTransactions;
+	uint32_t i2cBytes;			// including the address byte
+	uint32_t delayMs;			// blocking delay32Ms(), including the BMP180 delay_msec
+	uint32_t waitMs;			// input_wait(), the idle sleep of the main loop
+	uint32_t sspBytes;			// to the OLED
+	uint32_t eepromWrites;
+	uint32_t uartBytes;
+	uint32_t bmp180EarlyReads;	// ADC read before the conversion was done (virtual clock)
+};
+
+void sim_get_counters(struct sim_counters *pCounters);
+
+// Most writes any one EEPROM byte has taken since reset
+uint32_t sim_eeprom_max_wear(void);
+
+// Virtual clock (clock.c), in ms since reset. Advancing it calls the
+// firmware's SysTick_Handler() once per ms and fires the events that fall
+// due, in order. The replay harness never advances it; its time comes
+// from the capture.
+typedef void (*sim_event_fn)(void *pCtx);
+
+#define SIM_CLOCK_EVENTS	64
+
+void     sim_clock_reset(void);
+uint64_t sim_clock_now(void);
+
+// Calls fn(pCtx) when the clock reaches atMs (now, if that has passed).
+// Returns -1 if SIM_CLOCK_EVENTS are already pending.
+int      sim_clock_at(uint64_t atMs, sim_event_fn fn, void *pCtx);
+
+// Advances the clock by ms. If pWake is given it is asked after every
+// event, and the clock stops early once it returns true. Returns the ms
+// advanced.
+uint32_t sim_clock_run(uint32_t ms, uint8_t (*pWake)(void));
+
+// Firmware entry points
+int  ws_firmware_main(void);
+void SysTick_Handler(void);
+
+// Runs the firmware until sim_stop(); returns the status passed to it.
+int  sim_run_firmware(void);
+void sim_stop(int status);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,480 @@
+/*
+ * soak.c
+ *
+ *  Runs the firmware for days of virtual time and checks it keeps working:
+ *
+ *      ws_soak [-d days] [-s seed]
+ *
+ *  The firmware is built as fielded, without RECORD_ENABLE, and with its
+ *  tick counter starting an hour short of the 2^32 ms wrap
+ *  (MS_TICKS_START), so every run crosses it. Sensors
+ *  follow a daily cycle, and user input arrives at random times, queued
+ *  on the virtual clock like the GPIO interrupts would queue it. Now and
+ *  then the I2C bus glitches and fails a few transfers in a row.
+ *
+ *  The run fails if a telemetry frame is missing, late or out of order
+ *  (across the wrap too), if the main loop stalls, or if the BMP180 is
+ *  read before its conversion is done, a telemetry pressure is outside
+ *  what the simulated BMP180 can produce, the I2C errors in the firmware's
+ *  metrics disagree with the glitches, an input takes longer than a pass
+ *  to reach the OLED, or the uptime and EEPROM writes in the firmware's
+ *  metrics or the I2C energy in its energy frames disagree with the
+ *  simulation. It reports the share of time the core would spend at full
+ *  clock, the latency histograms, metrics and energy estimate the
+ *  firmware sends, the EEPROM wear and how fast virtual time ran.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "../../WeatherStation5000/include/clockmgr.h"
+#include "../../WeatherStation5000/include/energy.h"
+#include "../../WeatherStation5000/include/frame.h"
+#include "../../WeatherStation5000/include/input.h"
+#include "../../WeatherStation5000/include/latency.h"
+#include "../../WeatherStation5000/include/metrics.h"
+#include "../../WeatherStation5000/include/telemetry.h"
+
+#define DAY_MS				(24ULL * 3600 * 1000)
+#define INPUT_QUEUE			16
+#define INPUT_GAP_MAX_MS	(30 * 60 * 1000)
+
+// I2C bus time per byte, as board.c counts it
+#define I2C_BYTE_US			90
+
+// One I2C transfer in I2C_GLITCH_ONE_IN starts a glitch failing up to
+// I2C_GLITCH_MAX transfers, enough to outlast the i2csched retries
+#define I2C_GLITCH_ONE_IN	10000
+#define I2C_GLITCH_MAX		3
+
+// Pressures the simulated front and noise compensate to, Pa
+#define PRESSURE_MIN		68000
+#define PRESSURE_MAX		74000
+
+// Longest a pass may take: the 255 ms maximum loop delay plus sampling
+#define PASS_MAX_MS			500
+
+// 24LC08 endurance, write cycles per byte
+#define EEPROM_ENDURANCE	1000000
+
+static uint8_t inputQueue[INPUT_QUEUE];
+static uint64_t inputAt[INPUT_QUEUE];
+static uint32_t inputHead = 0, inputTail = 0;
+static uint32_t inputsQueued = 0;
+
+static uint32_t i2cGlitchLeft = 0, i2cFailed = 0;
+
+static struct frame_decoder txDecoder;
+static uint32_t samples = 0, passes = 0, failures = 0;
+static uint16_t lastSeq;
+static uint32_t lastSampleMs;
+static uint64_t lastSampleAt, lastPassAt, longestPass = 0, wrapAt = 0;
+static uint8_t passOpen = 0;			// inside the input drain of a pass
+
+static const char *pathNames[LATENCY_PATHS] = { "sample->oled", "input->page", "sample->uart" };
+static uint32_t latencyCounts[LATENCY_PATHS][LATENCY_BUCKETS];
+static uint32_t latencyMax[LATENCY_PATHS];
+
+// Latest metrics frames, and the virtual time of the last one
+static uint32_t metrics[METRICS];
+static uint64_t metricsAt = 0;
+
+// Energy frames summed: uW x ms (nJ) per subsystem, and per sample
+static const char *subsystemNames[ENERGY_SUBSYSTEMS] = {
+	"board", "cpu fast", "cpu idle", "i2c", "bmp180", "oled", "uart"
+};
+static uint64_t energyNj[ENERGY_SUBSYSTEMS];
+static uint64_t energyMs = 0, energySampleUj = 0;
+static uint32_t energyFrames = 0;
+
+static uint32_t rngState;
+
+//------------------------------------------------------------------------
+static uint32_t rng(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+// 0..1 over the day, 0 at midnight
+static double day_phase(void)
+{
+	return (double)(sim_clock_now() % DAY_MS) / DAY_MS;
+}
+
+static void fail(const char *pWhat, uint32_t value)
+{
+	if (failures++ < 10)
+		printf("FAIL at %.3f h: %s (%u)\n", sim_clock_now() / 3600000.0, pWhat, value);
+}
+
+//------------------------------------------------------------------------
+void sim_bmp180_prom(uint8_t *pProm)
+{
+	// Bosch datasheet example calibration
+	static const uint8_t prom[SIM_BMP180_PROM_SIZE] = {
+		0x01, 0x98, 0xFF, 0xB8, 0xC7, 0xD1, 0x7F, 0xE5, 0x7F, 0xF5, 0x5A,
+		0x71, 0x18, 0x2E, 0x00, 0x04, 0x80, 0x00, 0xDD, 0xF9, 0x0B, 0x34
+	};
+
+	memcpy(pProm, prom, sizeof(prom));
+}
+
+uint16_t sim_bmp180_ut(void)
+{
+	// About 15 C at night, 25 C in the afternoon
+	return (uint16_t)(27898 + 650 * (1 - cos(2 * M_PI * day_phase())) + rng() % 4);
+}
+
+uint32_t sim_bmp180_up(uint8_t oss)
+{
+	// A weather front every few days
+	double days = sim_clock_now() / (double)DAY_MS;
+
+	return (uint32_t)((23843 + 400 * sin(2 * M_PI * days / 3.7) + rng() % 8) * (1 << oss));
+}
+
+int32_t sim_temp_read(void)
+{
+	return (int32_t)(200 - 50 * cos(2 * M_PI * day_phase())) + (int32_t)(rng() % 3);
+}
+
+uint32_t sim_light_read(void)
+{
+	double sun = sin(2 * M_PI * (day_phase() - 0.25));
+
+	return (sun > 0) ? (uint32_t)(16000 * sun) + rng() % 50 : rng() % 3;
+}
+
+uint32_t sim_gpio_read(uint32_t port, uint32_t bit)
+{
+	return 1;
+}
+
+uint8_t sim_i2c_ok(void)
+{
+	if (i2cGlitchLeft == 0 && rng() % I2C_GLITCH_ONE_IN == 0)
+		i2cGlitchLeft = 1 + rng() % I2C_GLITCH_MAX;
+	if (i2cGlitchLeft == 0)
+		return 1;
+	i2cGlitchLeft--;
+	i2cFailed++;
+	return 0;
+}
+
+//------------------------------------------------------------------------
+static void schedule_input(void);
+
+static void input_arrives(void *pCtx)
+{
+	static const uint8_t choices[] = {
+		INPUT_LEFT, INPUT_RIGHT, INPUT_BUTTON, INPUT_ROTARY_LEFT, INPUT_ROTARY_RIGHT
+	};
+
+	if (inputHead - inputTail < INPUT_QUEUE)
+	{
+		inputAt[inputHead % INPUT_QUEUE] = sim_clock_now();
+		inputQueue[inputHead++ % INPUT_QUEUE] = choices[rng() % sizeof(choices)];
+		inputsQueued++;
+	}
+	schedule_input();
+}
+
+static void schedule_input(void)
+{
+	sim_clock_at(sim_clock_now() + 1 + rng() % INPUT_GAP_MAX_MS, input_arrives, NULL);
+}
+
+static uint8_t input_queued(void)
+{
+	return inputHead != inputTail;
+}
+
+// A pass of the main loop starts by draining the input queue
+static void pass_starts(void)
+{
+	uint64_t at = sim_clock_now();
+
+	if (passes > 0 && at - lastPassAt > longestPass)
+		longestPass = at - lastPassAt;
+	lastPassAt = at;
+	passes++;
+}
+
+uint8_t sim_input_get(void)
+{
+	if (!passOpen)
+	{
+		pass_starts();
+		passOpen = 1;
+	}
+	if (!input_queued())
+	{
+		passOpen = 0;
+		return INPUT_NONE;
+	}
+	return inputQueue[inputTail++ % INPUT_QUEUE];
+}
+
+uint32_t sim_input_age_ms(void)
+{
+	return input_queued() ? (uint32_t)(sim_clock_now() - inputAt[inputTail % INPUT_QUEUE]) : 0;
+}
+
+void sim_input_wait(uint32_t ms)
+{
+	sim_clock_run(ms, input_queued);
+}
+
+void sim_delay_ms(uint32_t ms)
+{
+	sim_clock_run(ms, NULL);
+}
+
+static void end_of_run(void *pCtx)
+{
+	sim_stop(0);
+}
+
+//------------------------------------------------------------------------
+static void check_sample(const uint8_t *pPayload)
+{
+	uint16_t seq = frame_get_u16(&pPayload[TLM_OFS_SEQ]);
+	uint32_t ms = frame_get_u32(&pPayload[TLM_OFS_MS]);
+	uint64_t at = sim_clock_now();
+
+	if (samples > 0)
+	{
+		if (seq != (uint16_t)(lastSeq + 1))
+			fail("telemetry sequence gap", seq);
+		// Unsigned difference, so the wrap of the tick counter is no gap
+		if (ms - lastSampleMs < TELEMETRY_PERIOD_MS)
+			fail("telemetry early, ms since the last", ms - lastSampleMs);
+		// Frames go out on new readings, at least every TELEMETRY_MAX_PERIOD_MS
+		if (at - lastSampleAt > TELEMETRY_MAX_PERIOD_MS + PASS_MAX_MS)
+			fail("telemetry late, ms since the last", (uint32_t)(at - lastSampleAt));
+		if (ms < lastSampleMs && wrapAt == 0)
+			wrapAt = at;
+	}
+	if (pPayload == txDecoder.payload && txDecoder.type == TLM_SAMPLE)
+	{
+		int32_t pressure = (int32_t)frame_get_u32(&pPayload[TLM_OFS_PRESSURE]);
+
+		if (pressure < PRESSURE_MIN || pressure > PRESSURE_MAX)
+			fail("telemetry pressure out of range, Pa", (uint32_t)pressure);
+	}
+	lastSeq = seq;
+	lastSampleMs = ms;
+	lastSampleAt = at;
+	samples++;
+}
+
+static void add_latency(const uint8_t *pPayload)
+{
+	uint8_t path = pPayload[TLM_OFS_LAT_PATH];
+	uint32_t maxMs = frame_get_u16(&pPayload[TLM_OFS_LAT_MAX]);
+	uint8_t b;
+
+	if (path >= LATENCY_PATHS)
+		return;
+	for (b = 0; b < LATENCY_BUCKETS; b++)
+		latencyCounts[path][b] += frame_get_u16(&pPayload[TLM_OFS_LAT_COUNTS + 2 * b]);
+	if (maxMs > latencyMax[path])
+		latencyMax[path] = maxMs;
+}
+
+static void print_latency(void)
+{
+	uint8_t path, b;
+
+	printf("%-14s", "latency ms");
+	for (b = 0; b < LATENCY_BUCKETS; b++)
+		printf(" %6u%s", latency_bucket_ms(b), b == LATENCY_BUCKETS - 1 ? "+" : "");
+	printf("   max\n");
+	for (path = 0; path < LATENCY_PATHS; path++)
+	{
+		printf("%-14s", pathNames[path]);
+		for (b = 0; b < LATENCY_BUCKETS; b++)
+			printf(" %6u", latencyCounts[path][b]);
+		printf(" %6u\n", latencyMax[path]);
+	}
+}
+
+static void take_metrics(const uint8_t *pPayload, uint8_t len)
+{
+	uint8_t first = pPayload[TLM_OFS_MET_FIRST];
+	uint8_t count = pPayload[TLM_OFS_MET_COUNT];
+	uint8_t i;
+
+	if (len != TLM_METRICS_SIZE(count) || first + count > METRICS)
+		return;
+	for (i = 0; i < count; i++)
+		metrics[first + i] = frame_get_u32(&pPayload[TLM_OFS_MET_VALUES + 4 * i]);
+	metricsAt = sim_clock_now();
+	// Counted as the transfers fail, and no transfer runs while a frame
+	// is sent
+	if (first <= METRIC_I2C_ERRORS && first + count > METRIC_I2C_ERRORS
+		&& metrics[METRIC_I2C_ERRORS] != i2cFailed)
+		fail("metrics I2C errors off", metrics[METRIC_I2C_ERRORS]);
+}
+
+static void print_metrics(void)
+{
+	uint8_t id;
+
+	printf("metrics:");
+	for (id = 0; id < METRICS; id++)
+		printf(" %s %u%s", metrics_name(id), metrics[id], id + 1 < METRICS ? "," : "\n");
+}
+
+static void add_energy(const uint8_t *pPayload)
+{
+	uint32_t intervalMs = frame_get_u32(&pPayload[TLM_OFS_EN_INTERVAL]);
+	uint8_t i;
+
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		energyNj[i] += (uint64_t)frame_get_u16(&pPayload[TLM_OFS_EN_POWER + 2 * i]) * intervalMs;
+	energyMs += intervalMs;
+	energySampleUj += frame_get_u32(&pPayload[TLM_OFS_EN_SAMPLE]);
+	energyFrames++;
+}
+
+static void print_energy(void)
+{
+	uint64_t total = 0;
+	uint8_t i;
+
+	if (energyMs == 0)
+		return;
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		total += energyNj[i];
+	printf("energy: %.2f mW, %.1f mWh a day, %.1f uJ a sample;", (double)total / energyMs / 1000,
+		(double)total / energyMs * 24 / 1000, (double)energySampleUj / energyFrames);
+	for (i = 0; i < ENERGY_SUBSYSTEMS; i++)
+		printf(" %s %.3f%s", subsystemNames[i], (double)energyNj[i] / energyMs / 1000,
+			i + 1 < ENERGY_SUBSYSTEMS ? "," : " mW\n");
+}
+
+void sim_uart_tx(const uint8_t *pData, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (frame_decoder_feed(&txDecoder, pData[i]) != FRAME_READY)
+			continue;
+		// Raw frames (TELEMETRY_RAW) carry the same sequence and time stamp
+		if ((txDecoder.type == TLM_SAMPLE && txDecoder.len == TLM_SAMPLE_SIZE)
+			|| (txDecoder.type == TLM_RAW && txDecoder.len == TLM_RAW_SIZE))
+			check_sample(txDecoder.payload);
+		else if (txDecoder.type == TLM_LATENCY && txDecoder.len == TLM_LATENCY_SIZE)
+			add_latency(txDecoder.payload);
+		else if (txDecoder.type == TLM_METRICS)
+			take_metrics(txDecoder.payload, txDecoder.len);
+		else if (txDecoder.type == TLM_ENERGY && txDecoder.len == TLM_ENERGY_SIZE)
+			add_energy(txDecoder.payload);
+	}
+}
+
+//------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+	struct timespec t0, t1;
+	struct sim_counters counters;
+	double days = 7, seconds;
+	uint32_t wear;
+	int opt;
+
+	rngState = 2463534242u;
+	while ((opt = getopt(argc, argv, "d:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd':
+			days = atof(optarg);
+			break;
+		case 's':
+			rngState = (uint32_t)strtoul(optarg, NULL, 0) | 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-d days] [-s seed]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	frame_decoder_init(&txDecoder);
+	sim_clock_reset();
+	sim_clock_at((uint64_t)(days * DAY_MS), end_of_run, NULL);
+	schedule_input();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	sim_run_firmware();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+	if (sim_clock_now() - lastPassAt > PASS_MAX_MS)
+		fail("main loop stalled, ms since the last pass", (uint32_t)(sim_clock_now() - lastPassAt));
+	if (longestPass > PASS_MAX_MS)
+		fail("pass too long, ms", (uint32_t)longestPass);
+	if (latencyMax[LATENCY_INPUT_PAGE] > PASS_MAX_MS)
+		fail("input took longer than a pass to the OLED, ms", latencyMax[LATENCY_INPUT_PAGE]);
+	if (wrapAt == 0)
+		fail("tick counter never wrapped, last sample at", lastSampleMs);
+
+	sim_get_counters(&counters);
+	if (counters.bmp180EarlyReads > 0)
+		fail("BMP180 read before its conversion was done, times", counters.bmp180EarlyReads);
+
+	// Uptime is counted in whole seconds at the end of a pass
+	if (metricsAt == 0)
+		fail("no metrics frames", 0);
+	else if (metrics[METRIC_UPTIME_S] > metricsAt / 1000
+		|| metricsAt / 1000 - metrics[METRIC_UPTIME_S] > PASS_MAX_MS / 1000 + 1)
+		fail("metrics uptime off, s", metrics[METRIC_UPTIME_S]);
+	if (metrics[METRIC_EEPROM_WRITES] != counters.eepromWrites)
+		fail("metrics EEPROM writes off", metrics[METRIC_EEPROM_WRITES]);
+
+	// The firmware's mean I2C power against the bytes the simulation
+	// moved, to 5% or the 1 uW the frames resolve
+	if (energyMs == 0)
+		fail("no energy frames", 0);
+	else
+	{
+		double firmware = (double)energyNj[ENERGY_I2C] / energyMs;
+		double sim = (double)energy_uj(ENERGY_I2C, (uint64_t)counters.i2cBytes * I2C_BYTE_US)
+			* 1000 / sim_clock_now();
+
+		if (fabs(firmware - sim) > 1 + 0.05 * sim)
+			fail("energy frames I2C uW off", (uint32_t)firmware);
+	}
+
+	wear = sim_eeprom_max_wear();
+	printf("%.2f days of station time in %.2f s (%.0fx)\n", days, seconds,
+		seconds > 0 ? days * DAY_MS / 1000.0 / seconds : 0.0);
+	printf("%u passes (longest %llu ms), %u telemetry samples, %u inputs\n",
+		passes, (unsigned long long)longestPass, samples, inputsQueued);
+	printf("tick counter wrapped after %.3f h\n", wrapAt / 3600000.0);
+	printf("i2c: %u transactions (%u failed), %u bytes; %u ms blocking delays\n",
+		counters.i2cTransactions, i2cFailed, counters.i2cBytes, counters.delayMs);
+	// Computing takes no virtual time, so this counts only the waits
+	// made at the PLL
+	printf("clock: %.1f%% of the time at the PLL, %u switches\n",
+		100.0 * clock_ms(CLOCK_FAST) / (clock_ms(CLOCK_FAST) + clock_ms(CLOCK_IDLE) + 1),
+		clock_switches());
+	print_latency();
+	print_metrics();
+	print_energy();
+	printf("eeprom: %u writes, worst byte %u cycles", counters.eepromWrites, wear);
+	if (wear > 0)
+		printf(", %.0f years to %u at this rate", days * EEPROM_ENDURANCE / wear / 365.25,
+			EEPROM_ENDURANCE);
+	printf("\n%s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * ram_report.c
+ *
+ *  Static RAM use per module, from the GNU ld map file of a firmware
+ *  build (Debug/WeatherStation5000.map):
+ *
+ *      ws_ram_report <map> [ram_bytes]
+ *
+ *  Sums the .data, .bss and COMMON input sections placed in output
+ *  sections named .data* or .bss*, and the functions in .ramfunc
+ *  (ramfunc.h), per object file, and prints them largest first; alignment padding between them is a module of its own. The RAM size is taken from the map's writable memory
+ *  regions (RamLoc8 on the LPC1343) unless given; what .data and .bss
+ *  leave of it is the room for the stack and heap, which the firmware's
+ *  stack high-water mark (TLM_MEMORY frames) measures at run time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MODULES		256
+#define MAX_NAME		96
+
+struct module {
+	char name[MAX_NAME];
+	unsigned long data;
+	unsigned long bss;
+	unsigned long code;
+};
+
+static struct module modules[MAX_MODULES];
+static int moduleCount = 0;
+
+static struct module *find_module(const char *pPath)
+{
+	const char *pName = strrchr(pPath, '/');
+	int i;
+
+	pName = (pName != NULL) ? pName + 1 : pPath;
+	for (i = 0; i < moduleCount; i++)
+		if (strcmp(modules[i].name, pName) == 0)
+			return &modules[i];
+	if (moduleCount == MAX_MODULES)
+		return NULL;
+	snprintf(modules[moduleCount].name, MAX_NAME, "%.95s", pName);
+	return &modules[moduleCount++];
+}
+
+static int starts_with(const char *pText, const char *pPrefix)
+{
+	return strncmp(pText, pPrefix, strlen(pPrefix)) == 0;
+}
+
+static int compare_total(const void *pA, const void *pB)
+{
+	const struct module *a = pA, *b = pB;
+	unsigned long ta = a->data + a->bss + a->code, tb = b->data + b->bss + b->code;
+
+	return (ta < tb) - (ta > tb);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *pFile;
+	char line[512], name[MAX_NAME], pending[MAX_NAME] = "", path[400], attrs[16];
+	unsigned long ram = 0, addr, size, dataTotal = 0, bssTotal = 0, codeTotal = 0, total;
+	int inMemory = 0, inMap = 0, output = 0;	// output: 0 none, 1 .data, 2 .bss, 3 .ramfunc
+	struct module *pMod;
+	int fields, i;
+
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "usage: %s <map> [ram_bytes]\n", argv[0]);
+		return 2;
+	}
+	if ((pFile = fopen(argv[1], "r")) == NULL)
+	{
+		perror(argv[1]);
+		return 2;
+	}
+
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		if (starts_with(line, "Memory Configuration"))
+		{
+			inMemory = 1;
+			continue;
+		}
+		if (starts_with(line, "Linker script and memory map"))
+		{
+			inMemory = 0;
+			inMap = 1;
+			continue;
+		}
+		if (inMemory)
+		{
+			// Name Origin Length Attributes
+			if (sscanf(line, "%95s 0x%lx 0x%lx %15s", name, &addr, &size, attrs) == 4
+				&& strcmp(name, "*default*") != 0 && strchr(attrs, 'w') != NULL)
+				ram += size;
+			continue;
+		}
+		if (!inMap || line[0] == '\n')
+			continue;
+
+		// Output sections start in column 0
+		if (line[0] != ' ')
+		{
+			if (sscanf(line, "%95s", name) == 1)
+				output = starts_with(name, ".data") ? 1 : starts_with(name, ".bss") ? 2
+					: starts_with(name, ".ramfunc") ? 3 : 0;
+			pending[0] = '\0';
+			continue;
+		}
+		if (output == 0)
+			continue;
+
+		// Input sections are indented by one space; a long name goes on a
+		// line of its own, with the address, size and file on the next
+		if (line[1] != ' ')
+		{
+			fields = sscanf(line, " %95s 0x%lx 0x%lx %399s", name, &addr, &size, path);
+			pending[0] = '\0';
+			if (fields == 1 && name[0] != '*')
+				snprintf(pending, sizeof(pending), "%s", name);
+			if (fields == 3 && strcmp(name, "*fill*") == 0)
+			{
+				strcpy(name, "COMMON");
+				strcpy(path, "(alignment)");
+				fields = 4;
+			}
+			if (fields != 4)
+				continue;
+		}
+		else if (pending[0] != '\0' && sscanf(line, " 0x%lx 0x%lx %399s", &addr, &size, path) == 3)
+		{
+			snprintf(name, sizeof(name), "%s", pending);
+			pending[0] = '\0';
+		}
+		else
+			continue;
+
+		if (!(starts_with(name, ".data") || starts_with(name, ".bss") || starts_with(name, ".ramfunc")
+			|| strcmp(name, "COMMON") == 0))
+			continue;
+		if (size == 0 || (pMod = find_module(path)) == NULL)
+			continue;
+		if (output == 1)
+		{
+			pMod->data += size;
+			dataTotal += size;
+		}
+		else if (output == 2)
+		{
+			pMod->bss += size;
+			bssTotal += size;
+		}
+		else
+		{
+			pMod->code += size;
+			codeTotal += size;
+		}
+	}
+	fclose(pFile);
+
+	if (argc == 3)
+		ram = strtoul(argv[2], NULL, 0);
+	if (ram == 0)
+		ram = 8192;
+
+	qsort(modules, moduleCount, sizeof(modules[0]), compare_total);
+	printf("%-32s %8s %8s %8s %8s\n", "module", "data", "bss", "code", "total");
+	for (i = 0; i < moduleCount; i++)
+		printf("%-32s %8lu %8lu %8lu %8lu\n", modules[i].name, modules[i].data, modules[i].bss,
+			modules[i].code, modules[i].data + modules[i].bss + modules[i].code);
+	total = dataTotal + bssTotal + codeTotal;
+	printf("%-32s %8lu %8lu %8lu %8lu\n", "total", dataTotal, bssTotal, codeTotal, total);
+
+	if (total > ram)
+	{
+		printf("FAIL: %lu bytes static, over the %lu bytes of RAM\n", total, ram);
+		return 1;
+	}
+	printf("%lu of %lu bytes RAM static, %lu left for the stack and heap\n",
+		total, ram, ram - total);
+	return 0;
+}